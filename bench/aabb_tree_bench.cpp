@@ -0,0 +1,106 @@
+/**
+ * aabb_tree_bench
+ *
+ * AABBTree at 1k, 10k and 100k moving bodies. Bodies of 16 to 48 world units are scattered so that each
+ * overlaps a few others, and move a few units per frame in a fixed direction, about what snake segments
+ * and creatures do. Reports the cost of building the tree with createProxy, and per frame the cost of
+ * moveProxy on every body and of queryPairs afterwards. An all pairs overlap test is the reference up to
+ * 10k bodies, past that it takes too long to be worth waiting for.
+ *
+ * Build the bench_aabb_tree target in Release and run it without arguments.
+ */
+
+#include "AABBTree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <vector>
+
+constexpr int FRAMES = 60;
+constexpr uint32_t BRUTE_FORCE_MAX_BODIES = 10'000;
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> bodySize(16.0f, 48.0f);
+    std::uniform_real_distribution<float> bodyVelocity(-4.0f, 4.0f);
+
+    std::printf("%8s | %11s | %12s | %13s | %8s | %7s | %10s | %14s\n", "bodies", "create ms", "move ms/frm",
+                "pairs ms/frm", "height", "moved %", "pairs/frm", "brute ms/frm");
+
+    for (uint32_t bodyCount : {1'000u, 10'000u, 100'000u})
+    {
+        float worldSize = 160.0f * std::sqrt(float(bodyCount));
+        std::uniform_real_distribution<float> bodyPos(0.0f, worldSize);
+
+        std::vector<AABB> bodies(bodyCount);
+        std::vector<glm::vec2> velocities(bodyCount);
+        for (uint32_t i = 0; i < bodyCount; i++)
+        {
+            glm::vec2 pos(bodyPos(rng), bodyPos(rng));
+            bodies[i] = {pos, pos + glm::vec2(bodySize(rng), bodySize(rng))};
+            velocities[i] = {bodyVelocity(rng), bodyVelocity(rng)};
+        }
+
+        // --- createProxy ---
+        AABBTree tree;
+        std::vector<uint32_t> proxies(bodyCount);
+        Clock::time_point createStart = Clock::now();
+        for (uint32_t i = 0; i < bodyCount; i++)
+            proxies[i] = tree.createProxy(bodies[i], Entity{i});
+        double createMs = msSince(createStart);
+        tree.queryPairs([](uint32_t, uint32_t) {});
+
+        // --- moveProxy and queryPairs, every frame ---
+        double moveMs = 0.0;
+        double pairsMs = 0.0;
+        size_t reinserted = 0;
+        size_t pairs = 0;
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            Clock::time_point moveStart = Clock::now();
+            for (uint32_t i = 0; i < bodyCount; i++)
+            {
+                bodies[i].min += velocities[i];
+                bodies[i].max += velocities[i];
+                reinserted += tree.moveProxy(proxies[i], bodies[i], velocities[i]);
+            }
+            moveMs += msSince(moveStart);
+
+            Clock::time_point pairsStart = Clock::now();
+            tree.queryPairs([&](uint32_t, uint32_t) { pairs++; });
+            pairsMs += msSince(pairsStart);
+        }
+
+        // --- Reference: every pair, one frame ---
+        double bruteMs = -1.0;
+        if (bodyCount <= BRUTE_FORCE_MAX_BODIES)
+        {
+            size_t overlapping = 0;
+            Clock::time_point bruteStart = Clock::now();
+            for (uint32_t i = 0; i < bodyCount; i++)
+                for (uint32_t j = i + 1; j < bodyCount; j++)
+                    overlapping += bodies[i].overlaps(bodies[j]);
+            bruteMs = msSince(bruteStart);
+            if (overlapping == SIZE_MAX)
+                std::printf(" ");
+        }
+
+        std::printf("%8u | %11.3f | %12.3f | %13.3f | %8d | %7.1f | %10.0f | ", bodyCount, createMs, moveMs / FRAMES,
+                    pairsMs / FRAMES, tree.height(), 100.0 * reinserted / (double(bodyCount) * FRAMES), double(pairs) / FRAMES);
+        if (bruteMs >= 0.0)
+            std::printf("%14.3f\n", bruteMs);
+        else
+            std::printf("%14s\n", "-");
+    }
+    return 0;
+}
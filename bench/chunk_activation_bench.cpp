@@ -0,0 +1,121 @@
+/**
+ * chunk_activation_bench
+ *
+ * Before/after of the Transform hot/cold split. Activating a chunk walks its Transform column, commits
+ * the model matrices and builds one instance per tile (see Game::addChunkEntities). "Before" is a
+ * Transform that still carries the fields that moved to TransformMeta (pivot and name) plus the removed
+ * dir, "after" is the Transform in components/Transform.h. Both use today's Affine2 model, so the only
+ * difference is the layout.
+ *
+ * Columns for many chunks are kept around and activated round robin so the data comes from memory the
+ * way it does when the player walks into chunks that were generated a while ago.
+ *
+ * Build the bench_chunk_activation target in Release and run it without arguments.
+ */
+
+#include "components/Transform.h"
+#include "components/TransformMeta.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+constexpr uint32_t TILES_PER_CHUNK = 32 * 32;
+constexpr uint32_t RESIDENT_CHUNKS = 2048; // Columns kept in memory, far more than the caches hold
+constexpr uint32_t ACTIVATIONS = 4096;
+constexpr int REPEATS = 5;
+
+// Transform before the split
+struct FatTransform
+{
+    glm::vec2 position;
+    glm::vec2 size;
+    glm::vec2 dir = glm::vec2(0.0f);
+    float rotation = 0.0f;
+    glm::vec2 pivotPoint = DEFAULT_PIVOT;
+    const char *name = "not defined";
+    Affine2 model;
+
+    void commit() {
+        model = Affine2::fromPlacement(position, size, rotation, pivotPoint);
+    }
+};
+
+// The per tile part of InstanceData that comes from the Transform
+struct TileInstance
+{
+    glm::mat4 model;
+    glm::vec2 size;
+};
+
+using Clock = std::chrono::steady_clock;
+
+template <typename T>
+static std::vector<T> makeColumns()
+{
+    std::vector<T> transforms(size_t(RESIDENT_CHUNKS) * TILES_PER_CHUNK);
+    for (uint32_t chunk = 0; chunk < RESIDENT_CHUNKS; chunk++)
+        for (uint32_t tile = 0; tile < TILES_PER_CHUNK; tile++)
+        {
+            T &t = transforms[size_t(chunk) * TILES_PER_CHUNK + tile];
+            t.position = glm::vec2(float(chunk * 32 + tile / 32), float(tile % 32)) * 16.0f;
+            t.size = glm::vec2(16.0f);
+        }
+    return transforms;
+}
+
+template <typename T>
+static void activate(T *column, std::vector<TileInstance> &instances)
+{
+    for (uint32_t tile = 0; tile < TILES_PER_CHUNK; tile++)
+    {
+        T &t = column[tile];
+        t.commit();
+        instances.push_back({t.model.toMat4(), t.size});
+    }
+}
+
+// Nanoseconds per chunk activation, best of REPEATS
+template <typename T>
+static double bench()
+{
+    std::vector<T> transforms = makeColumns<T>();
+    std::vector<TileInstance> instances;
+    instances.reserve(TILES_PER_CHUNK);
+
+    double best = 1e30;
+    float sink = 0.0f;
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < ACTIVATIONS; i++)
+        {
+            // Stride through the resident chunks so consecutive activations don't share cache lines
+            uint32_t chunk = (i * 7919) % RESIDENT_CHUNKS;
+            instances.clear();
+            activate(transforms.data() + size_t(chunk) * TILES_PER_CHUNK, instances);
+            sink += instances.back().model[3][0];
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ACTIVATIONS;
+        best = std::min(best, ns);
+    }
+
+    if (sink == 1.0f)
+        std::printf(" ");
+    return best;
+}
+
+int main()
+{
+    double before = bench<FatTransform>();
+    double after = bench<Transform>();
+
+    std::printf("Transform size: before %zu B, after %zu B (+%zu B TransformMeta, only where needed)\n",
+                sizeof(FatTransform), sizeof(Transform), sizeof(TransformMeta));
+    std::printf("Column of %u tiles: before %.1f KiB, after %.1f KiB\n", TILES_PER_CHUNK,
+                TILES_PER_CHUNK * sizeof(FatTransform) / 1024.0, TILES_PER_CHUNK * sizeof(Transform) / 1024.0);
+    std::printf("Chunk activation: before %.1f us, after %.1f us (%.2fx)\n", before / 1000.0, after / 1000.0,
+                before / after);
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * tile_sweep_bench
+ *
+ * sweepCircleHitsSolidTilesMulti (TileSweep.h) against the two pass sweep it replaced, which tested every
+ * tile in the bounding box of the sweep once for the earliest entry time and once more to gather the hits
+ * at that time. The old version is kept below as the baseline.
+ *
+ * A 5x5 chunk window is filled with random solid tiles at two densities, then circles of the drill's
+ * radius are swept in random directions over increasing lengths. Reported in ns per sweep, best of
+ * REPEATS, along with how often the two disagree on the earliest hit time.
+ *
+ * Build the bench_tile_sweep target in Release and run it without arguments.
+ */
+
+#include "TileSweep.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+constexpr float SWEEP_RADIUS = 16.0f;
+constexpr uint32_t SWEEPS_PER_LENGTH = 20'000;
+constexpr int REPEATS = 5;
+
+// --- Baseline: the two pass sweep ---
+static bool sweepTwoPass(const ChunkWindow &window, const glm::vec2 &startCenter, const glm::vec2 &endCenter,
+                         float radius, TileHitList &out)
+{
+    out.tFirst = 1.0f;
+    out.count = 0;
+
+    glm::vec2 minP = glm::min(startCenter, endCenter) - glm::vec2(radius);
+    glm::vec2 maxP = glm::max(startCenter, endCenter) + glm::vec2(radius);
+
+    int32_t minTX = worldToTileCoord(minP.x);
+    int32_t maxTX = worldToTileCoord(maxP.x);
+    int32_t minTY = worldToTileCoord(minP.y);
+    int32_t maxTY = worldToTileCoord(maxP.y);
+
+    // ---- pass 1: find earliest t ----
+    bool found = false;
+    float bestT = 1.0f;
+
+    for (int32_t ty = minTY; ty <= maxTY; ++ty)
+        for (int32_t tx = minTX; tx <= maxTX; ++tx)
+        {
+            TileRef tile = window.tileAt(tx, ty);
+            if (!tile.chunk->isSolid(tile.tileIdx)) continue;
+
+            glm::vec2 bmin = glm::vec2((float)tx, (float)ty) * float(TILE_WORLD_SIZE);
+            glm::vec2 bmax = bmin + glm::vec2(TILE_WORLD_SIZE);
+
+            glm::vec2 emin = bmin - glm::vec2(radius);
+            glm::vec2 emax = bmax + glm::vec2(radius);
+
+            float tEnter;
+            if (segmentIntersectsAABB(startCenter, endCenter, emin, emax, tEnter))
+            {
+                if (tEnter >= 0.0f && tEnter < bestT)
+                {
+                    bestT = tEnter;
+                    found = true;
+                }
+            }
+        }
+
+    if (!found) return false;
+
+    // ---- pass 2: gather all hits at same time ----
+    const float tEps = 1e-4f;
+    out.tFirst = bestT;
+
+    for (int32_t ty = minTY; ty <= maxTY; ++ty)
+        for (int32_t tx = minTX; tx <= maxTX; ++tx)
+        {
+            if (out.count == 4) break;
+
+            TileRef tile = window.tileAt(tx, ty);
+            if (!tile.chunk->isSolid(tile.tileIdx)) continue;
+
+            glm::vec2 bmin = glm::vec2((float)tx, (float)ty) * float(TILE_WORLD_SIZE);
+            glm::vec2 bmax = bmin + glm::vec2(TILE_WORLD_SIZE);
+
+            glm::vec2 emin = bmin - glm::vec2(radius);
+            glm::vec2 emax = bmax + glm::vec2(radius);
+
+            float tEnter;
+            if (segmentIntersectsAABB(startCenter, endCenter, emin, emax, tEnter))
+            {
+                if (tEnter >= 0.0f && tEnter <= bestT + tEps && !out.contains(tile)) {
+                    out.hits[out.count++] = { tx, ty, tEnter, tile };
+                    out.visited[out.visitedCount++] = tile;
+                }
+            }
+        }
+
+    return out.count > 0;
+}
+
+// --- World ---
+struct World
+{
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    ChunkWindow window;
+
+    World(uint32_t solidPermille, std::mt19937 &rng)
+    {
+        for (int32_t chunkX = -CHUNK_WINDOW_RADIUS; chunkX <= CHUNK_WINDOW_RADIUS; chunkX++)
+            for (int32_t chunkY = -CHUNK_WINDOW_RADIUS; chunkY <= CHUNK_WINDOW_RADIUS; chunkY++)
+            {
+                auto chunk = std::make_unique<Chunk>(chunkX * CHUNK_WORLD_SIZE, chunkY * CHUNK_WORLD_SIZE);
+                for (int32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
+                    chunk->tileTypes[tileIdx] = rng() % 1000 < solidPermille ? TileType::Ground : TileType::Empty;
+                chunk->rebuildSolidMask();
+                chunks.push_back(std::move(chunk));
+            }
+
+        window.recenter(0, 0, [&](int32_t chunkX, int32_t chunkY) -> Chunk * {
+            for (std::unique_ptr<Chunk> &chunk : chunks)
+                if (chunk->chunkX == chunkX * CHUNK_WORLD_SIZE && chunk->chunkY == chunkY * CHUNK_WORLD_SIZE)
+                    return chunk.get();
+            return nullptr;
+        });
+    }
+};
+
+struct Sweep
+{
+    glm::vec2 start;
+    glm::vec2 end;
+};
+
+// Random sweeps of the given length that stay inside the window
+static std::vector<Sweep> makeSweeps(float length, std::mt19937 &rng)
+{
+    const float lo = -CHUNK_WINDOW_RADIUS * float(CHUNK_WORLD_SIZE) + SWEEP_RADIUS + length + 1.0f;
+    const float hi = (CHUNK_WINDOW_RADIUS + 1) * float(CHUNK_WORLD_SIZE) - SWEEP_RADIUS - length - 1.0f;
+    std::uniform_real_distribution<float> pos(lo, hi);
+    std::uniform_real_distribution<float> angle(0.0f, 6.28318530718f);
+
+    std::vector<Sweep> sweeps(SWEEPS_PER_LENGTH);
+    for (Sweep &sweep : sweeps)
+    {
+        float a = angle(rng);
+        sweep.start = {pos(rng), pos(rng)};
+        sweep.end = sweep.start + glm::vec2(std::cos(a), std::sin(a)) * length;
+    }
+    return sweeps;
+}
+
+using Clock = std::chrono::steady_clock;
+
+template <typename SweepFn>
+static double nsPerSweep(const World &world, const std::vector<Sweep> &sweeps, SweepFn &&sweepFn)
+{
+    double best = 1e30;
+    uint32_t sink = 0;
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        Clock::time_point start = Clock::now();
+        for (const Sweep &sweep : sweeps)
+        {
+            TileHitList hits;
+            sink += sweepFn(world.window, sweep.start, sweep.end, SWEEP_RADIUS, hits) ? hits.count : 0;
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(sweeps.size());
+        best = std::min(best, ns);
+    }
+
+    if (sink == UINT32_MAX)
+        std::printf(" ");
+    return best;
+}
+
+// Sweeps where the two disagree on whether and when the circle hits first
+static uint32_t mismatches(const World &world, const std::vector<Sweep> &sweeps)
+{
+    uint32_t count = 0;
+    for (const Sweep &sweep : sweeps)
+    {
+        TileHitList a, b;
+        bool hitA = sweepTwoPass(world.window, sweep.start, sweep.end, SWEEP_RADIUS, a);
+        bool hitB = sweepCircleHitsSolidTilesMulti(world.window, sweep.start, sweep.end, SWEEP_RADIUS, b);
+        if (hitA != hitB || (hitA && std::abs(a.tFirst - b.tFirst) > 1e-4f))
+            count++;
+    }
+    return count;
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    const float lengths[] = {4.0f, 16.0f, 64.0f, 256.0f, 768.0f};
+
+    for (uint32_t solidPermille : {300u, 30u})
+    {
+        World world(solidPermille, rng);
+        std::printf("%.0f%% solid, radius %.0f, %u sweeps per length\n", solidPermille / 10.0, SWEEP_RADIUS, SWEEPS_PER_LENGTH);
+        std::printf("%8s | %12s | %12s | %8s | %10s\n", "length", "two pass ns", "walk ns", "speedup", "mismatches");
+        for (float length : lengths)
+        {
+            std::vector<Sweep> sweeps = makeSweeps(length, rng);
+            double before = nsPerSweep(world, sweeps, sweepTwoPass);
+            double after = nsPerSweep(world, sweeps, sweepCircleHitsSolidTilesMulti);
+            std::printf("%8.0f | %12.1f | %12.1f | %7.2fx | %10u\n", length, before, after, before / after,
+                        mismatches(world, sweeps));
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
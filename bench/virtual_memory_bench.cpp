@@ -0,0 +1,177 @@
+/**
+ * virtual_memory_bench
+ *
+ * Streams components into a dense array the way ComponentStorage::growDense does, once with the old
+ * malloc growth (allocate, clear, copy, free) and once with VirtualRange reserve/commit. Entities arrive
+ * one chunk at a time, so besides the total time this reports the slowest chunk, which is the hitch the
+ * player sees while walking into new terrain.
+ *
+ * Build the bench_virtual_memory target in Release and run it without arguments.
+ */
+
+#include "VirtualMemory.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+// Same growth step as ComponentStorage
+constexpr uint32_t MEM_CHUNK_SIZE = 0x10000;
+constexpr uint32_t MAX_ENTITIES = 1 << 24;
+constexpr uint32_t ENTITIES_PER_CHUNK = 32 * 32;
+constexpr int REPEATS = 5;
+
+// About the size of the components that live in global storage
+struct Component
+{
+    float values[12];
+};
+
+using Clock = std::chrono::steady_clock;
+
+static uint32_t roundUpChunk(uint32_t need)
+{
+    return (need + MEM_CHUNK_SIZE - 1) / MEM_CHUNK_SIZE * MEM_CHUNK_SIZE;
+}
+
+// --- Old growth: a new block per step, everything copied over ---
+struct MallocDense
+{
+    Component *dense = nullptr;
+    uint32_t *denseToEntity = nullptr;
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+
+    ~MallocDense()
+    {
+        free(dense);
+        free(denseToEntity);
+    }
+
+    void grow(uint32_t need)
+    {
+        uint32_t newCapacity = roundUpChunk(need);
+        Component *newDense = (Component *)malloc(size_t(newCapacity) * sizeof(Component));
+        uint32_t *newDenseToEntity = (uint32_t *)malloc(size_t(newCapacity) * sizeof(uint32_t));
+        if (!newDense || !newDenseToEntity)
+            throw std::bad_alloc();
+
+        std::memset(newDense, 0xFF, size_t(newCapacity) * sizeof(Component));
+        std::memset(newDenseToEntity, 0xFF, size_t(newCapacity) * sizeof(uint32_t));
+        if (dense)
+            std::memcpy(newDense, dense, size_t(size) * sizeof(Component));
+        if (denseToEntity)
+            std::memcpy(newDenseToEntity, denseToEntity, size_t(size) * sizeof(uint32_t));
+
+        free(dense);
+        free(denseToEntity);
+        dense = newDense;
+        denseToEntity = newDenseToEntity;
+        capacity = newCapacity;
+    }
+
+    void push(uint32_t entity, const Component &c)
+    {
+        if (size == capacity)
+            grow(size + 1);
+        dense[size] = c;
+        denseToEntity[size] = entity;
+        size++;
+    }
+};
+
+// --- New growth: one reservation, pages committed as needed ---
+struct ReservedDense
+{
+    VirtualRange denseRange;
+    VirtualRange denseToEntityRange;
+    Component *dense = nullptr;
+    uint32_t *denseToEntity = nullptr;
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+
+    ~ReservedDense()
+    {
+        denseRange.release();
+        denseToEntityRange.release();
+    }
+
+    void grow(uint32_t need)
+    {
+        if (!denseRange.base)
+        {
+            denseRange.reserve(size_t(MAX_ENTITIES) * sizeof(Component));
+            denseToEntityRange.reserve(size_t(MAX_ENTITIES) * sizeof(uint32_t));
+            dense = (Component *)denseRange.base;
+            denseToEntity = (uint32_t *)denseToEntityRange.base;
+        }
+
+        uint32_t newCapacity = roundUpChunk(need);
+        denseRange.commitTo(size_t(newCapacity) * sizeof(Component));
+        denseToEntityRange.commitTo(size_t(newCapacity) * sizeof(uint32_t));
+        capacity = newCapacity;
+    }
+
+    void push(uint32_t entity, const Component &c)
+    {
+        if (size == capacity)
+            grow(size + 1);
+        dense[size] = c;
+        denseToEntity[size] = entity;
+        size++;
+    }
+};
+
+struct StreamResult
+{
+    double totalMs = 0.0;
+    double worstChunkUs = 0.0;
+};
+
+template <typename Dense>
+static StreamResult stream(uint32_t entityCount)
+{
+    StreamResult best{1e30, 1e30};
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        Dense storage;
+        Component c{};
+        double worstUs = 0.0;
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t first = 0; first < entityCount; first += ENTITIES_PER_CHUNK)
+        {
+            Clock::time_point chunkStart = Clock::now();
+            uint32_t last = std::min(first + ENTITIES_PER_CHUNK, entityCount);
+            for (uint32_t entity = first; entity < last; entity++)
+            {
+                c.values[0] = float(entity);
+                storage.push(entity, c);
+            }
+            worstUs = std::max(worstUs, std::chrono::duration<double, std::micro>(Clock::now() - chunkStart).count());
+        }
+        double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        best.totalMs = std::min(best.totalMs, totalMs);
+        best.worstChunkUs = std::min(best.worstChunkUs, worstUs);
+    }
+    return best;
+}
+
+int main()
+{
+    std::printf("%10s | %22s | %22s\n", "", "malloc growth", "reserve/commit");
+    std::printf("%10s | %10s %11s | %10s %11s\n", "entities", "total ms", "worst us", "total ms", "worst us");
+
+    for (uint32_t entityCount : {10'000u, 100'000u, 1'000'000u, 2'000'000u})
+    {
+        StreamResult old = stream<MallocDense>(entityCount);
+        StreamResult reserved = stream<ReservedDense>(entityCount);
+        std::printf("%10u | %10.2f %11.1f | %10.2f %11.1f\n", entityCount, old.totalMs, old.worstChunkUs,
+                    reserved.totalMs, reserved.worstChunkUs);
+    }
+    return 0;
+}
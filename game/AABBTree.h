@@ -0,0 +1,406 @@
+/**
+ * AABBTree
+ *
+ * Broadphase for things that move: snake segments now, creatures and projectiles later. Tiles don't go
+ * in here, they have Chunk::solidMask.
+ *
+ * A dynamic bounding volume tree over fat AABBs. A proxy's leaf holds its AABB grown by AABB_TREE_MARGIN
+ * and stretched along the last displacement, so as long as the real AABB stays inside, moving it is a
+ * containment check and nothing else. Once it gets out, the leaf is taken out and put back in, which
+ * refits and rebalances only the path to the root. Inserts go next to the sibling that grows the tree's
+ * total perimeter the least and rotations keep the height logarithmic, so a region query, or the pair
+ * query of one moved proxy, costs O(log n) plus what it finds.
+ *
+ * Nodes are pooled in one array and recycled through a free list. Proxy ids are leaf node indices and
+ * stay valid until destroyProxy.
+ */
+
+#pragma once
+#include "components/AABB.h"
+#include "components/Entity.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+constexpr uint32_t AABB_NULL_NODE = UINT32_MAX;
+constexpr float AABB_TREE_MARGIN = 8.0f;               // World units a fat AABB reaches past the real one
+constexpr float AABB_TREE_DISPLACEMENT_FACTOR = 4.0f;  // Fat AABBs also reach this many displacements ahead
+constexpr uint32_t AABB_TREE_STACK_SIZE = 256;         // Traversal stack, a balanced tree never gets close
+
+struct AABBNode
+{
+    AABB box;               // Fat for leaves, the union of both children otherwise
+    uint32_t parent;        // Next free node while on the free list
+    uint32_t child1;
+    uint32_t child2;
+    int32_t height;         // 0 for leaves, -1 while free
+    Entity userData;
+    bool moved;             // Reinserted since the last queryPairs
+
+    bool isLeaf() const { return child1 == AABB_NULL_NODE; }
+};
+
+struct AABBNodePool
+{
+    std::vector<AABBNode> nodes;
+    uint32_t freeList = AABB_NULL_NODE;
+    uint32_t liveCount = 0;
+
+    AABBNode &operator[](uint32_t idx)
+    {
+        assert(idx < nodes.size());
+        return nodes[idx];
+    }
+
+    const AABBNode &operator[](uint32_t idx) const
+    {
+        assert(idx < nodes.size());
+        return nodes[idx];
+    }
+
+    // Invalidates references into the pool
+    uint32_t allocate()
+    {
+        uint32_t idx;
+        if (freeList != AABB_NULL_NODE)
+        {
+            idx = freeList;
+            freeList = nodes[idx].parent;
+        }
+        else
+        {
+            idx = (uint32_t)nodes.size();
+            nodes.emplace_back();
+        }
+
+        nodes[idx] = {{}, AABB_NULL_NODE, AABB_NULL_NODE, AABB_NULL_NODE, 0, Entity(), false};
+        liveCount++;
+        return idx;
+    }
+
+    void release(uint32_t idx)
+    {
+        nodes[idx].parent = freeList;
+        nodes[idx].height = -1;
+        freeList = idx;
+        liveCount--;
+    }
+};
+
+struct AABBTree
+{
+    AABBNodePool pool;
+    uint32_t root = AABB_NULL_NODE;
+    uint32_t proxyCount = 0;
+    std::vector<uint32_t> moveBuffer; // Proxies created or reinserted since the last queryPairs
+
+    uint32_t createProxy(const AABB &aabb, Entity userData)
+    {
+        uint32_t proxy = pool.allocate();
+        AABBNode &node = pool[proxy];
+        node.box = fatten(aabb, {0.0f, 0.0f});
+        node.userData = userData;
+        node.moved = true;
+        moveBuffer.push_back(proxy);
+        insertLeaf(proxy);
+        proxyCount++;
+        return proxy;
+    }
+
+    void destroyProxy(uint32_t proxy)
+    {
+        assert(pool[proxy].isLeaf() && pool[proxy].height == 0);
+        if (pool[proxy].moved)
+        {
+            auto it = std::find(moveBuffer.begin(), moveBuffer.end(), proxy);
+            *it = moveBuffer.back();
+            moveBuffer.pop_back();
+        }
+        removeLeaf(proxy);
+        pool.release(proxy);
+        proxyCount--;
+    }
+
+    /**
+     * Updates a proxy to its new real AABB, displacement being how far it moved since the last call.
+     * Returns true if the leaf had to be reinserted.
+     */
+    bool moveProxy(uint32_t proxy, const AABB &aabb, glm::vec2 displacement)
+    {
+        assert(pool[proxy].isLeaf() && pool[proxy].height == 0);
+
+        // Still inside, and the fat box hasn't grown stale from an earlier, faster move
+        AABB fat = fatten(aabb, displacement);
+        const AABB &current = pool[proxy].box;
+        AABB stale = {fat.min - glm::vec2(4.0f * AABB_TREE_MARGIN), fat.max + glm::vec2(4.0f * AABB_TREE_MARGIN)};
+        if (current.contains(aabb) && stale.contains(current))
+            return false;
+
+        removeLeaf(proxy);
+        pool[proxy].box = fat;
+        insertLeaf(proxy);
+
+        if (!pool[proxy].moved)
+        {
+            pool[proxy].moved = true;
+            moveBuffer.push_back(proxy);
+        }
+        return true;
+    }
+
+    const AABB &fatAABB(uint32_t proxy) const
+    {
+        return pool[proxy].box;
+    }
+
+    Entity userData(uint32_t proxy) const
+    {
+        return pool[proxy].userData;
+    }
+
+    int32_t height() const
+    {
+        return root == AABB_NULL_NODE ? 0 : pool[root].height;
+    }
+
+    /**
+     * Calls fn for every proxy whose fat AABB overlaps region.
+     * fn: bool(uint32_t proxy), return false to stop
+     */
+    template <typename Fn>
+    void query(const AABB &region, Fn &&fn) const
+    {
+        if (root == AABB_NULL_NODE)
+            return;
+
+        uint32_t stack[AABB_TREE_STACK_SIZE];
+        uint32_t count = 0;
+        stack[count++] = root;
+        while (count > 0)
+        {
+            const AABBNode &node = pool[stack[--count]];
+            if (!node.box.overlaps(region))
+                continue;
+
+            if (node.isLeaf())
+            {
+                if (!fn(uint32_t(&node - pool.nodes.data())))
+                    return;
+                continue;
+            }
+
+            assert(count + 2 <= AABB_TREE_STACK_SIZE && "AABBTree too deep");
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+
+    /**
+     * Calls fn once for every pair of proxies whose fat AABBs overlap and of which at least one was
+     * created or moved since the last call. Pairs that were overlapping before and both stood still
+     * are not reported again, whoever needs them keeps them.
+     * fn: void(uint32_t proxyA, uint32_t proxyB)
+     */
+    template <typename Fn>
+    void queryPairs(Fn &&fn)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        for (uint32_t proxy : moveBuffer)
+        {
+            query(pool[proxy].box, [&](uint32_t other) {
+                // A pair of two moved proxies is reported from the lower one only
+                if (other == proxy || (pool[other].moved && other < proxy))
+                    return true;
+                fn(proxy, other);
+                return true;
+            });
+        }
+
+        for (uint32_t proxy : moveBuffer)
+            pool[proxy].moved = false;
+        moveBuffer.clear();
+    }
+
+private:
+    static AABB fatten(const AABB &aabb, glm::vec2 displacement)
+    {
+        AABB fat = {aabb.min - glm::vec2(AABB_TREE_MARGIN), aabb.max + glm::vec2(AABB_TREE_MARGIN)};
+        glm::vec2 ahead = displacement * AABB_TREE_DISPLACEMENT_FACTOR;
+        fat.min += glm::min(ahead, glm::vec2(0.0f));
+        fat.max += glm::max(ahead, glm::vec2(0.0f));
+        return fat;
+    }
+
+    void insertLeaf(uint32_t leaf)
+    {
+        if (root == AABB_NULL_NODE)
+        {
+            root = leaf;
+            pool[leaf].parent = AABB_NULL_NODE;
+            return;
+        }
+
+        // --- Find the sibling that grows the tree the least ---
+        AABB leafBox = pool[leaf].box;
+        uint32_t index = root;
+        while (!pool[index].isLeaf())
+        {
+            const AABBNode &node = pool[index];
+            float area = node.box.perimeter();
+            float combinedArea = mergeAABB(node.box, leafBox).perimeter();
+
+            // Pairing with this node: a new parent over both
+            float cost = 2.0f * combinedArea;
+            // Going further down: this node grows either way
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            auto descendCost = [&](uint32_t child) {
+                const AABBNode &c = pool[child];
+                float merged = mergeAABB(leafBox, c.box).perimeter();
+                return (c.isLeaf() ? merged : merged - c.box.perimeter()) + inheritanceCost;
+            };
+            float cost1 = descendCost(node.child1);
+            float cost2 = descendCost(node.child2);
+
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+        uint32_t sibling = index;
+
+        // --- New parent over sibling and leaf ---
+        uint32_t oldParent = pool[sibling].parent;
+        uint32_t newParent = pool.allocate();
+        pool[newParent].parent = oldParent;
+        pool[newParent].box = mergeAABB(leafBox, pool[sibling].box);
+        pool[newParent].height = pool[sibling].height + 1;
+        pool[newParent].child1 = sibling;
+        pool[newParent].child2 = leaf;
+        pool[sibling].parent = newParent;
+        pool[leaf].parent = newParent;
+
+        if (oldParent == AABB_NULL_NODE)
+            root = newParent;
+        else if (pool[oldParent].child1 == sibling)
+            pool[oldParent].child1 = newParent;
+        else
+            pool[oldParent].child2 = newParent;
+
+        refitFrom(pool[leaf].parent);
+    }
+
+    void removeLeaf(uint32_t leaf)
+    {
+        if (leaf == root)
+        {
+            root = AABB_NULL_NODE;
+            return;
+        }
+
+        uint32_t parent = pool[leaf].parent;
+        uint32_t grandParent = pool[parent].parent;
+        uint32_t sibling = pool[parent].child1 == leaf ? pool[parent].child2 : pool[parent].child1;
+
+        if (grandParent == AABB_NULL_NODE)
+        {
+            root = sibling;
+            pool[sibling].parent = AABB_NULL_NODE;
+            pool.release(parent);
+            return;
+        }
+
+        if (pool[grandParent].child1 == parent)
+            pool[grandParent].child1 = sibling;
+        else
+            pool[grandParent].child2 = sibling;
+        pool[sibling].parent = grandParent;
+        pool.release(parent);
+
+        refitFrom(grandParent);
+    }
+
+    // Rebalances and refits every node from index up to the root
+    void refitFrom(uint32_t index)
+    {
+        while (index != AABB_NULL_NODE)
+        {
+            index = balance(index);
+
+            AABBNode &node = pool[index];
+            const AABBNode &child1 = pool[node.child1];
+            const AABBNode &child2 = pool[node.child2];
+            node.height = 1 + std::max(child1.height, child2.height);
+            node.box = mergeAABB(child1.box, child2.box);
+
+            index = node.parent;
+        }
+    }
+
+    /**
+     * If one child of a is more than one level taller than the other, rotates that child up into a's
+     * place. Returns the node that is at a's position afterwards.
+     */
+    uint32_t balance(uint32_t a)
+    {
+        AABBNode &nodeA = pool[a];
+        if (nodeA.isLeaf() || nodeA.height < 2)
+            return a;
+
+        uint32_t b = nodeA.child1;
+        uint32_t c = nodeA.child2;
+        int32_t skew = pool[c].height - pool[b].height;
+        if (skew > 1)
+            return rotateUp(a, c, b);
+        if (skew < -1)
+            return rotateUp(a, b, c);
+        return a;
+    }
+
+    // Moves tall (a child of a) into a's place, a takes the shorter grandchild under tall
+    uint32_t rotateUp(uint32_t a, uint32_t tall, uint32_t other)
+    {
+        AABBNode &nodeA = pool[a];
+        AABBNode &nodeTall = pool[tall];
+        uint32_t f = nodeTall.child1;
+        uint32_t g = nodeTall.child2;
+
+        // --- tall takes a's place ---
+        nodeTall.child1 = a;
+        nodeTall.parent = nodeA.parent;
+        nodeA.parent = tall;
+
+        if (nodeTall.parent == AABB_NULL_NODE)
+            root = tall;
+        else if (pool[nodeTall.parent].child1 == a)
+            pool[nodeTall.parent].child1 = tall;
+        else
+            pool[nodeTall.parent].child2 = tall;
+
+        // --- The taller grandchild stays under tall, the shorter one goes to a ---
+        uint32_t keep = f, give = g;
+        if (pool[f].height < pool[g].height)
+            std::swap(keep, give);
+
+        nodeTall.child2 = keep;
+        if (nodeA.child1 == tall)
+            nodeA.child1 = give;
+        else
+            nodeA.child2 = give;
+        pool[give].parent = a;
+
+        nodeA.box = mergeAABB(pool[other].box, pool[give].box);
+        nodeA.height = 1 + std::max(pool[other].height, pool[give].height);
+        nodeTall.box = mergeAABB(nodeA.box, pool[keep].box);
+        nodeTall.height = 1 + std::max(nodeA.height, pool[keep].height);
+        return tall;
+    }
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include "../libs/glm/glm.hpp"
+#include <cmath>
+#include <cstdint>
+
+// 2D affine transform, the 2x3 part of a model matrix that a 2D game actually uses.
+// world = local.x * col0 + local.y * col1 + translation
+struct Affine2
+{
+    glm::vec2 col0 = {1.0f, 0.0f};
+    glm::vec2 col1 = {0.0f, 1.0f};
+    glm::vec2 translation = {0.0f, 0.0f};
+
+    glm::vec2 apply(glm::vec2 local) const
+    {
+        return col0 * local.x + col1 * local.y + translation;
+    }
+
+    // Expands to the mat4 layout the vertex shaders take as instance input
+    glm::mat4 toMat4() const
+    {
+        glm::mat4 m(1.0f);
+        m[0] = glm::vec4(col0, 0.0f, 0.0f);
+        m[1] = glm::vec4(col1, 0.0f, 0.0f);
+        m[3] = glm::vec4(translation, 0.0f, 1.0f);
+        return m;
+    }
+
+    /**
+     * Closed form of translate(position) * translate(pivot) * rotate(rotation) * translate(-pivot) * scale(size),
+     * where pivot = size * pivotPoint. Unrotated transforms skip the trig entirely.
+     */
+    static Affine2 fromPlacement(glm::vec2 position, glm::vec2 size, float rotation, glm::vec2 pivotPoint)
+    {
+        if (rotation == 0.0f)
+            return {{size.x, 0.0f}, {0.0f, size.y}, position};
+
+        float c = cosf(rotation);
+        float s = sinf(rotation);
+        glm::vec2 pivot = size * pivotPoint;
+        glm::vec2 rotatedPivot = {c * pivot.x - s * pivot.y, s * pivot.x + c * pivot.y};
+        return {
+            {c * size.x, s * size.x},
+            {-s * size.y, c * size.y},
+            position + pivot - rotatedPivot,
+        };
+    }
+};
@@ -1,7 +1,6 @@
 #pragma once
 #include "components/EntityType.h"
 #include "components/Material.h"
-#include "components/Health.h"
 #include "components/GroundOre.h"
 #include "EntityManager.h"
 #include "SnakeMath.h"
@@ -10,21 +9,107 @@
 #include "../libs/glm/common.hpp"
 #include "Globals.h"
 #include "Colors.h"
+#include "Noise.h"
+#include "WorldRandom.h"
+#include <chrono>
 
 // PROFILING
 #ifdef _DEBUG
 #include "tracy/Tracy.hpp"
 #endif
 
-inline const char *GROUND_NAME = "ground";
 inline const char *SPRITE_KEY = "ground_mid_1";
 
+enum class TileDecorationKind : uint8_t
+{
+    None,
+    Cosmetic,
+    Ore,
+};
+
+enum class Biome : uint8_t
+{
+    Bedrock,  // Mostly solid, the odd pocket
+    Tunnels,
+    Caverns,  // Wide open spaces
+    COUNT,
+};
+
+struct BiomeDef
+{
+    float biomeNoiseMax;   // The biome covers tiles whose biome noise is below this
+    float caveThreshold;   // Tiles whose cave noise is below this are carved out
+    double cosmeticChance;
+};
+
+inline constexpr BiomeDef BIOMES[(size_t)Biome::COUNT] = {
+    {0.40f, 0.30f, 0.002},
+    {0.60f, 0.40f, 0.005},
+    {1.00f, 0.48f, 0.008},
+};
+
+// An ore shows up from minDepth (in tiles below y = 0) on. Deeper tiles roll between every band they reach,
+// so keep the bands sorted by minDepth.
+struct OreBand
+{
+    int32_t minDepth;
+    ItemId ore;
+};
+
+inline constexpr OreBand ORE_BANDS[] = {
+    {INT32_MIN, ItemId::COPPER_ORE},
+    {96, ItemId::HEMATITE_ORE},
+};
+
+struct TileDecoration
+{
+    TileDecorationKind kind = TileDecorationKind::None;
+    uint32_t variant = 0; // Index into GROUND_COSMETICS or oreDatabase
+};
+
+// Everything needed to fill a chunk, produced without touching the ECS. Indexed like the chunk's tile layer.
+struct ChunkBlueprint
+{
+    int32_t chunkX = 0;
+    int32_t chunkY = 0;
+    float planMicros = 0.0f;
+    TileType tileTypes[TILES_PER_CHUNK];
+    uint8_t tileHealth[TILES_PER_CHUNK];
+    TileDecoration decorations[TILES_PER_CHUNK];
+};
+
+// Generation cost, accumulated on the main thread as chunks get committed
+struct ChunkGenStats
+{
+    uint32_t chunks = 0;
+    double planMicros = 0.0;   // Worker or main thread, whoever planned the chunk
+    double commitMicros = 0.0;
+    float maxPlanMicros = 0.0f;
+};
+
 struct CaveSystem
 {
     const float tileSize = 32.0f;
+    const float groundHealth = 100.0f; // What TILE_HEALTH_FULL stands for
     uint32_t lastMapIndex = 19;
     glm::vec2 size = {tileSize, tileSize};
     Material material = Material{Colors::fromHex(Colors::WHITE, 1.0f), ShaderType::Texture, AtlasIndex::Sprite, {32.0f, 32.0f}};
+    ChunkBlueprint scratchBlueprint;
+    ChunkGenStats genStats;
+
+    // Scratch for commitGround
+    std::vector<EntityDesc> decorationDescs;
+    std::vector<uint32_t> decorationTiles;
+    std::vector<Entity> decorationEntities;
+    std::vector<uint32_t> oreIndices;
+    std::vector<GroundOre> ores;
+
+    // --- World seed. Noise layers and WorldRandom are derived from it, see setSeed ---
+    uint32_t seed = 0;
+    NoiseLayer caveNoise;
+    NoiseLayer biomeNoise;
+    NoiseLayer oreNoise;
+    float oreThreshold = 0.84f; // Ore veins where ore noise is above this, about 1% of tiles
     static constexpr int TREASURE_COUNT = 10;
     std::array<SpriteID, TREASURE_COUNT> GROUND_COSMETICS = {
         SpriteID::SPR_GEM_BLUE,
@@ -44,179 +129,297 @@ struct CaveSystem
         return coord * tileSize;
     }
 
-    void createInstanceData(Entity entity, Transform transform, Material material, Mesh mesh, glm::vec4 uvTransform)
+    CaveSystem()
     {
-        #ifdef _DEBUG
-        ZoneScoped;
-        #endif
-        Renderable *renderable = (Renderable*)ecs->find(ComponentId::Renderable, entity);
-        InstanceData instance = {
-            transform.model,
+        setSeed(std::random_device{}());
+    }
+
+    // The same seed generates the same world, whatever order the chunks are generated in
+    void setSeed(uint32_t worldSeed)
+    {
+        seed = worldSeed;
+        caveNoise = {.seed = seed, .frequency = 1.0f / 24.0f, .octaves = 3};
+        biomeNoise = {.seed = seed ^ 0xB1053EEDu, .frequency = 1.0f / 160.0f, .octaves = 2};
+        oreNoise = {.seed = seed ^ 0x0BE5EEDu, .frequency = 1.0f / 5.0f, .octaves = 2};
+    }
+
+    // Instance data shared by every ground tile. Only model, color alpha and instanceKey differ per tile.
+    InstanceData groundTileInstance() const
+    {
+        AtlasRegion region = atlasRegions[SpriteID::SPR_GROUND_MID_1];
+        Mesh mesh = MeshRegistry::quad;
+        Renderable renderable = {Entity{}, 0, 0, RenderLayer::World};
+        renderable.packDrawKey(material.shaderType, mesh.vertexOffset);
+
+        return InstanceData{
+            glm::mat4(1.0f),
             material.color,
-            uvTransform,
-            transform.size,
+            getUvTransform(region),
+            size,
             material.size,
-            renderable->renderLayer,
+            renderable.renderLayer,
             material.shaderType,
-            renderable->z,
-            renderable->tiebreak,
+            renderable.z,
+            renderable.tiebreak,
             mesh,
             material.atlasIndex,
-            renderable->drawkey,
-            entity,
+            renderable.drawkey,
+            0,
         };
-
-        instanceStorage->push(instance);
     }
-    
-    Entity createGroundCosmetic(Entity &groundEntity, Transform &transform, uint32_t key)
+
+    EntityDesc groundCosmeticDesc(const Transform &transform, uint32_t key) const
     {
         Material m = Material{Colors::fromHex(Colors::WHITE, 1.0f), ShaderType::Texture, AtlasIndex::Sprite, {32.0f, 32.0f}};
         AtlasRegion region = atlasRegions[key];
-        glm::vec4 uvTransform = getUvTransform(region);
-        Mesh mesh = MeshRegistry::quad;
-        Entity entity = ecs->createEntity(
-            transform,
-            mesh,
-            m,
-            RenderLayer::World,
-            EntityType::GroundCosmetic,
-            SpatialStorage::Chunk,
-            uvTransform,
-            1);
-        GroundCosmetic groundCosmetic = {groundEntity};
-        ecs->push(ComponentId::GroundCosmetic, entity, &groundCosmetic);
-
-        return entity;
+        return {transform, MeshRegistry::quad, m, RenderLayer::World, EntityType::GroundCosmetic, getUvTransform(region), 1};
     }
 
-    Entity createGroundOre(Entity &groundEntity, Transform &transform, OreDef orePackage)
+    // GroundOre is pushed separately, see commitGround
+    EntityDesc groundOreDesc(const Transform &transform, const OreDef &orePackage) const
     {
         Material m = Material{Colors::fromHex(Colors::WHITE, 1.0f), ShaderType::Texture, AtlasIndex::Sprite, {32.0f, 32.0f}};
         AtlasRegion region = atlasRegions[orePackage.spriteID];
-        glm::vec4 uvTransform = getUvTransform(region);
-        Mesh mesh = MeshRegistry::quad;
-        Entity entity = ecs->createEntity(
-            transform,
-            mesh,
-            m,
-            RenderLayer::World,
-            EntityType::OreBlock,
-            SpatialStorage::Chunk,
-            uvTransform,
-            1);
-        GroundOre groundOre = { .itemId = orePackage.itemId, .parentRef = groundEntity, .oreLevel = orePackage.level  };
-        ecs->push(ComponentId::GroundOre, entity, &groundOre);
-
-        return entity;
-    }
-
-    Entity createRandomGroundCosmetic(Entity &groundEntity, Transform &t)
-    {
-        int idx = std::lround(SnakeMath::randomBetween(0, TREASURE_COUNT - 1));
-        uint32_t key = GROUND_COSMETICS[idx];
-        return createGroundCosmetic(groundEntity, t, key);
+        return {transform, MeshRegistry::quad, m, RenderLayer::World, EntityType::OreBlock, getUvTransform(region), 1};
     }
 
-    Entity createRandomOreBlock(Entity &groundEntity, Transform &transform)
-    {
-        // TODO: This should be based on something more interesting like "depth" or "biome"
-        ItemId idx = (ItemId)std::lround(SnakeMath::randomBetween(0, oreDatabase.count - 1));
-        OreDef orePackage = oreDatabase[idx];
-        return createGroundOre(groundEntity, transform, orePackage);
-    }
+    // --- Planning. Touches nothing but the blueprint, so it may run on any thread ---
 
-    inline void createGround(float xWorld, float yWorld)
+    /**
+     * Puts ground tiles at the given positions and rolls their decorations, every other tile of the
+     * chunk is left empty. Every position must be inside the chunk.
+     */
+    void planGround(int32_t chunkWorldX, int32_t chunkWorldY, const glm::vec2 *positions, uint32_t count, ChunkBlueprint &blueprint) const
     {
         #ifdef _DEBUG
         ZoneScoped;
         #endif
 
-        glm::vec2 position = {xWorld, yWorld};
-        Transform transform = { .position = position, .size = size, .name = GROUND_NAME };
-        transform.commit();
-        AtlasRegion region = atlasRegions[SpriteID::SPR_GROUND_MID_1];
-        glm::vec4 uvTransform = getUvTransform(region);
-        Mesh mesh = MeshRegistry::quad;
-        Ground ground = Ground{};
-        Entity entity = ecs->createEntity(
-            transform,
-            mesh,
-            material,
-            RenderLayer::World,
-            EntityType::Ground,
-            SpatialStorage::ChunkTile,
-            uvTransform,
-            0);
-
-        if (SnakeMath::chance(0.005)) {
-            createRandomGroundCosmetic(entity, transform);
-        } else if (SnakeMath::chance(0.005)) {
-            ground.groundOreRef = createRandomOreBlock(entity, transform);
+        assert(count <= TILES_PER_CHUNK);
+        auto start = std::chrono::steady_clock::now();
+        blueprint.chunkX = chunkWorldX;
+        blueprint.chunkY = chunkWorldY;
+        std::memset(blueprint.tileTypes, 0, sizeof(blueprint.tileTypes));
+        std::memset(blueprint.tileHealth, 0, sizeof(blueprint.tileHealth));
+        std::fill(std::begin(blueprint.decorations), std::end(blueprint.decorations), TileDecoration{});
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            int32_t localTileX = ((int32_t)positions[i].x - chunkWorldX) / TILE_WORLD_SIZE;
+            int32_t localTileY = ((int32_t)positions[i].y - chunkWorldY) / TILE_WORLD_SIZE;
+            assert(localTileX >= 0 && localTileX < TILES_PER_ROW);
+            assert(localTileY >= 0 && localTileY < TILES_PER_ROW);
+            int32_t tileIdx = localIndexToTileIndex(localTileX, localTileY);
+            blueprint.tileTypes[tileIdx] = TileType::Ground;
+            blueprint.tileHealth[tileIdx] = TILE_HEALTH_FULL;
+
+            TileDecoration &decoration = blueprint.decorations[tileIdx];
+            if (WorldRandom::chance(seed, chunkWorldX, chunkWorldY, tileIdx, RandomPurpose::Cosmetic, 0.005f)) {
+                decoration = rollCosmetic(chunkWorldX, chunkWorldY, tileIdx);
+            } else if (WorldRandom::chance(seed, chunkWorldX, chunkWorldY, tileIdx, RandomPurpose::Ore, 0.005f)) {
+                decoration = rollOre(chunkWorldX, chunkWorldY, tileIdx);
+            }
         }
-        
-        Health health = Health{100, 100};
-        ecs->push(ComponentId::Health, entity, &health);
-        ecs->push(ComponentId::Ground, entity, &ground);
+
+        std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        blueprint.planMicros = elapsed.count();
     }
 
-    inline void createGraceArea()
+    /**
+     * A full chunk, shaped by noise: biome noise picks the biome, cave noise carves the biome's caves
+     * and ore noise lays out ore veins, which get their ore from the depth bands.
+     */
+    void planChunk(int32_t chunkWorldX, int32_t chunkWorldY, ChunkBlueprint &blueprint) const
     {
         #ifdef _DEBUG
         ZoneScoped;
         #endif
 
-        float xMin = -1 * (float)(2 * CHUNK_WORLD_SIZE);
-        float xMax = (float)(3 * CHUNK_WORLD_SIZE);
-        float yMin = -1 * (float)(2 * CHUNK_WORLD_SIZE);
-        float yMax = (float)(3 * CHUNK_WORLD_SIZE);
-        float cx = 0.0f;
-        float cy = 0.0f;
-        float radiusInner = 512.0f;
+        auto start = std::chrono::steady_clock::now();
+        blueprint.chunkX = chunkWorldX;
+        blueprint.chunkY = chunkWorldY;
 
-        for (int dx = -2; dx <= 2; dx++)
+        float caves[TILES_PER_CHUNK];
+        float biomes[TILES_PER_CHUNK];
+        float ores[TILES_PER_CHUNK];
+        float cosmeticRolls[TILES_PER_CHUNK];
+        Noise::fillChunk(caveNoise, chunkWorldX, chunkWorldY, caves);
+        Noise::fillChunk(biomeNoise, chunkWorldX, chunkWorldY, biomes);
+        Noise::fillChunk(oreNoise, chunkWorldX, chunkWorldY, ores);
+        WorldRandom::fillUnit(seed, chunkWorldX, chunkWorldY, RandomPurpose::Cosmetic, cosmeticRolls);
+
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
         {
-            for (int dy = -2; dy <= 2; dy++)
-            {
-                int32_t cx = dx * CHUNK_WORLD_SIZE;
-                int32_t cy = dy * CHUNK_WORLD_SIZE;
+            TileDecoration &decoration = blueprint.decorations[tileIdx];
+            decoration = {};
 
-                ecs->chunks.emplace(
-                    packChunkCoords(cx, cy),
-                    Chunk{cx, cy});
+            const BiomeDef &biome = biomeAt(biomes[tileIdx]);
+            if (caves[tileIdx] < biome.caveThreshold)
+            {
+                blueprint.tileTypes[tileIdx] = TileType::Empty;
+                blueprint.tileHealth[tileIdx] = 0;
+                continue;
             }
+
+            blueprint.tileTypes[tileIdx] = TileType::Ground;
+            blueprint.tileHealth[tileIdx] = TILE_HEALTH_FULL;
+            if (ores[tileIdx] > oreThreshold)
+                decoration = rollOre(chunkWorldX, chunkWorldY, tileIdx);
+            else if (cosmeticRolls[tileIdx] < biome.cosmeticChance)
+                decoration = rollCosmetic(chunkWorldX, chunkWorldY, tileIdx);
         }
 
-        for (float y = yMin; y < yMax; y += tileSize)
+        std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        blueprint.planMicros = elapsed.count();
+    }
+
+    // The 5x5 chunks around spawn, see planGraceChunk
+    static bool isGraceChunk(int32_t chunkWorldX, int32_t chunkWorldY)
+    {
+        return std::abs(chunkWorldX) <= 2 * CHUNK_WORLD_SIZE && std::abs(chunkWorldY) <= 2 * CHUNK_WORLD_SIZE;
+    }
+
+    // Ground everywhere except for an empty ellipse around spawn
+    void planGraceChunk(int32_t chunkWorldX, int32_t chunkWorldY, ChunkBlueprint &blueprint) const
+    {
+        float cx = 0.0f;
+        float cy = 0.0f;
+        float radiusInner = 512.0f;
+
+        glm::vec2 positions[TILES_PER_CHUNK];
+        uint32_t count = 0;
+        for (int32_t y = chunkWorldY; y < chunkWorldY + CHUNK_WORLD_SIZE; y += tileSize)
         {
-            for (float x = xMin; x < xMax; x += tileSize)
+            for (int32_t x = chunkWorldX; x < chunkWorldX + CHUNK_WORLD_SIZE; x += tileSize)
             {
-                float dx = (x - cx) / 1.3f;
-                float dy = (y - cy) / 0.8f;
-                float dist = sqrtf(dx * dx + dy * dy);
+                float ex = (x - cx) / 1.3f;
+                float ey = (y - cy) / 0.8f;
+                float dist = sqrtf(ex * ex + ey * ey);
 
                 if (dist < radiusInner)
                     continue;
 
-                createGround(x, y);
+                positions[count++] = glm::vec2{(float)x, (float)y};
             }
         }
+
+        planGround(chunkWorldX, chunkWorldY, positions, count, blueprint);
     }
 
-    void generateNewChunk(int64_t &chunkIdx, int32_t &chunkWorldX, int32_t &chunkWorldY)
+    // Whatever chunk sits at these coordinates, as it was first generated
+    void planWorldChunk(int32_t chunkWorldX, int32_t chunkWorldY, ChunkBlueprint &blueprint) const
+    {
+        if (isGraceChunk(chunkWorldX, chunkWorldY))
+            planGraceChunk(chunkWorldX, chunkWorldY, blueprint);
+        else
+            planChunk(chunkWorldX, chunkWorldY, blueprint);
+    }
+
+    static const BiomeDef &biomeAt(float biomeNoiseValue)
+    {
+        for (size_t i = 0; i + 1 < (size_t)Biome::COUNT; i++)
+            if (biomeNoiseValue < BIOMES[i].biomeNoiseMax)
+                return BIOMES[i];
+        return BIOMES[(size_t)Biome::COUNT - 1];
+    }
+
+    TileDecoration rollCosmetic(int32_t chunkWorldX, int32_t chunkWorldY, uint32_t tileIdx) const
+    {
+        uint32_t variant = WorldRandom::below(seed, chunkWorldX, chunkWorldY, tileIdx, RandomPurpose::CosmeticVariant, TREASURE_COUNT);
+        return {TileDecorationKind::Cosmetic, variant};
+    }
+
+    TileDecoration rollOre(int32_t chunkWorldX, int32_t chunkWorldY, uint32_t tileIdx) const
+    {
+        int32_t tileY = chunkWorldY / TILE_WORLD_SIZE + int32_t(tileIdx % TILES_PER_ROW);
+        uint32_t reachedBands = 0;
+        for (const OreBand &band : ORE_BANDS)
+            if (tileY >= band.minDepth)
+                reachedBands++;
+        assert(reachedBands > 0);
+
+        uint32_t band = WorldRandom::below(seed, chunkWorldX, chunkWorldY, tileIdx, RandomPurpose::OreBand, reachedBands);
+        return {TileDecorationKind::Ore, (uint32_t)ORE_BANDS[band].ore};
+    }
+
+    // --- Commit. Main thread only ---
+
+    /**
+     * Copies a planned tile layer into its chunk and creates the decoration entities on top of it.
+     * The chunk itself must already exist in ecs->chunks.
+     */
+    void commitGround(const ChunkBlueprint &blueprint)
     {
         #ifdef _DEBUG
         ZoneScoped;
         #endif
 
-        ecs->chunks.emplace(chunkIdx, Chunk{chunkWorldX, chunkWorldY});
-        for (int32_t y = chunkWorldY; y < chunkWorldY + CHUNK_WORLD_SIZE; y += tileSize)
+        auto start = std::chrono::steady_clock::now();
+        Chunk &chunk = ecs->getChunk(packChunkCoords(blueprint.chunkX, blueprint.chunkY));
+
+        // --- Tile layer ---
+        std::memcpy(chunk.tileTypes, blueprint.tileTypes, sizeof(chunk.tileTypes));
+        std::memcpy(chunk.tileHealth, blueprint.tileHealth, sizeof(chunk.tileHealth));
+        chunk.rebuildSolidMask();
+
+        // --- Decorations, created in one batch ---
+        decorationDescs.clear();
+        decorationTiles.clear();
+        ores.clear();
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
         {
-            int32_t xMax = chunkWorldX + CHUNK_WORLD_SIZE;
-            for (int32_t x = chunkWorldX; x < xMax; x += tileSize)
+            const TileDecoration &decoration = blueprint.decorations[tileIdx];
+            if (decoration.kind == TileDecorationKind::None)
+                continue;
+
+            Transform transform = { .position = chunk.tileWorldPos(tileIdx), .size = size };
+            transform.commit();
+
+            if (decoration.kind == TileDecorationKind::Cosmetic)
+            {
+                decorationDescs.push_back(groundCosmeticDesc(transform, GROUND_COSMETICS[decoration.variant]));
+            }
+            else
             {
-                createGround(x, y);
+                const OreDef &ore = oreDatabase[(ItemId)decoration.variant];
+                decorationDescs.push_back(groundOreDesc(transform, ore));
+                ores.push_back({ .itemId = ore.itemId, .oreLevel = ore.level });
             }
+            decorationTiles.push_back(tileIdx);
         }
+
+        uint32_t decorationCount = (uint32_t)decorationDescs.size();
+        chunk.overlays.reserve(decorationCount);
+        ecs->reserveChunkEntities(chunk, decorationCount);
+        decorationEntities.resize(decorationCount);
+        ecs->createEntities(decorationDescs, SpatialStorage::Chunk, decorationEntities.data());
+
+        oreIndices.clear();
+        for (uint32_t i = 0; i < decorationCount; i++)
+        {
+            uint32_t tileIdx = decorationTiles[i];
+            chunk.tileOverlays[tileIdx] = (uint16_t)chunk.overlays.size();
+            chunk.overlays.push_back(decorationEntities[i]);
+            if (decorationDescs[i].entityType == EntityType::OreBlock)
+                oreIndices.push_back(entityIndex(decorationEntities[i]));
+        }
+        ecs->pushRange<GroundOre>(oreIndices.data(), (uint32_t)oreIndices.size(), [&](uint32_t i) { return ores[i]; });
+
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        genStats.chunks++;
+        genStats.planMicros += blueprint.planMicros;
+        genStats.commitMicros += elapsed.count();
+        genStats.maxPlanMicros = std::max(genStats.maxPlanMicros, blueprint.planMicros);
+    }
+
+    // Cheap main thread half of generating a chunk that was planned on a worker
+    void commitChunk(const ChunkBlueprint &blueprint)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        ecs->createChunk(blueprint.chunkX, blueprint.chunkY);
+        commitGround(blueprint);
     }
 };
\ No newline at end of file
@@ -3,6 +3,14 @@
 #include "components/Transform.h"
 #include "../libs/glm/glm.hpp"
 #include <vector>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CHUNK_SOLIDITY_AVX2 1
+#endif
 
 const int32_t CHUNK_WORLD_SIZE = 1024;
 const int32_t TILE_WORLD_SIZE = 32;
@@ -11,14 +19,126 @@ constexpr int32_t TILES_PER_CHUNK = TILES_PER_ROW * TILES_PER_ROW;
 static constexpr int CHUNK_SHIFT = 5;                     // because 32 == 2^5
 static constexpr int CHUNK_MASK = (1 << CHUNK_SHIFT) - 1; // 31
 
+enum class TileType : uint8_t
+{
+    Empty,
+    Ground,
+};
+
+constexpr uint8_t TILE_HEALTH_FULL = 255;
+constexpr uint16_t NO_TILE_OVERLAY = UINT16_MAX;
+
+/**
+ * Chunk
+ *
+ * Tiles are not entities. They live in the chunk as plain arrays indexed by localIndexToTileIndex, which
+ * is about 4 bytes per tile. Only things that sit on top of a tile (ores, cosmetics) are entities, and a
+ * tile finds those through tileOverlays.
+ *
+ * solidMask mirrors tileTypes as one bit per tile, in tile index order: word localX, bit localY. Queries
+ * that only care about solid or not (collision, particles, lighting, pathfinding) read those 128 bytes
+ * instead of the tile arrays, and can reject a whole block of tiles with a few ANDs. Change tile types
+ * through setTileType, or call rebuildSolidMask after writing tileTypes directly.
+ */
 struct Chunk
 {
     int32_t chunkX;
     int32_t chunkY;
-    Entity tiles[TILES_PER_CHUNK];
-    std::vector<Entity> staticEntities;
 
-    Chunk(int32_t chunkX, int32_t chunkY) : chunkX(chunkX), chunkY(chunkY) { staticEntities.reserve(1024); }
+    // --- Tile layer ---
+    TileType tileTypes[TILES_PER_CHUNK];
+    uint8_t tileHealth[TILES_PER_CHUNK];    // 0..TILE_HEALTH_FULL
+    uint16_t tileOverlays[TILES_PER_CHUNK]; // Index into overlays, NO_TILE_OVERLAY when there is none
+    uint32_t solidMask[TILES_PER_ROW];      // Bit localY of word localX is set if that tile is solid
+
+    std::vector<Entity> overlays;
+    std::vector<Entity> staticEntities; // Unordered, EntityLocation::staticIndex points back in here
+    uint32_t arena = UINT32_MAX;      // Index into EntityManager::arenas, assigned when the first entity is placed
+    uint32_t renderSlot = UINT32_MAX; // Tile instance range while the chunk is drawn, see tileInstanceKey
+    bool unsaved = false;             // Drilled since its delta was last written to disk, see ChunkResidency
+
+    Chunk(int32_t chunkX, int32_t chunkY) : chunkX(chunkX), chunkY(chunkY)
+    {
+        std::memset(tileTypes, 0, sizeof(tileTypes));
+        std::memset(tileHealth, 0, sizeof(tileHealth));
+        std::memset(tileOverlays, 0xFF, sizeof(tileOverlays));
+        std::memset(solidMask, 0, sizeof(solidMask));
+    }
+
+    bool isSolid(uint32_t tileIdx) const
+    {
+        return (solidMask[tileIdx >> CHUNK_SHIFT] >> (tileIdx & CHUNK_MASK)) & 1u;
+    }
+
+    void setTileType(uint32_t tileIdx, TileType type)
+    {
+        tileTypes[tileIdx] = type;
+        uint32_t bit = 1u << (tileIdx & CHUNK_MASK);
+        if (type != TileType::Empty)
+            solidMask[tileIdx >> CHUNK_SHIFT] |= bit;
+        else
+            solidMask[tileIdx >> CHUNK_SHIFT] &= ~bit;
+    }
+
+    void rebuildSolidMask()
+    {
+        for (int32_t localX = 0; localX < TILES_PER_ROW; localX++)
+        {
+            const TileType *column = tileTypes + localX * TILES_PER_ROW;
+            uint32_t word = 0;
+            for (int32_t localY = 0; localY < TILES_PER_ROW; localY++)
+                word |= uint32_t(column[localY] != TileType::Empty) << localY;
+            solidMask[localX] = word;
+        }
+    }
+
+    // True if any tile in the inclusive local rectangle is solid
+    bool anySolid(int32_t localX0, int32_t localY0, int32_t localX1, int32_t localY1) const
+    {
+        assert(0 <= localX0 && localX0 <= localX1 && localX1 < TILES_PER_ROW);
+        assert(0 <= localY0 && localY0 <= localY1 && localY1 < TILES_PER_ROW);
+
+        // Bits localY0..localY1, without shifting by 32
+        uint32_t rows = (UINT32_MAX >> (CHUNK_MASK - (localY1 - localY0))) << localY0;
+        int32_t localX = localX0;
+
+#ifdef CHUNK_SOLIDITY_AVX2
+        const __m256i rows8 = _mm256_set1_epi32(int32_t(rows));
+        for (; localX + 8 <= localX1 + 1; localX += 8)
+        {
+            __m256i words = _mm256_loadu_si256((const __m256i *)(solidMask + localX));
+            if (!_mm256_testz_si256(words, rows8))
+                return true;
+        }
+#endif
+        for (; localX <= localX1; localX++)
+        {
+            if (solidMask[localX] & rows)
+                return true;
+        }
+        return false;
+    }
+
+    // World position of the tile's top left corner
+    glm::vec2 tileWorldPos(uint32_t tileIdx) const
+    {
+        return {
+            float(chunkX + int32_t(tileIdx / TILES_PER_ROW) * TILE_WORLD_SIZE),
+            float(chunkY + int32_t(tileIdx % TILES_PER_ROW) * TILE_WORLD_SIZE),
+        };
+    }
+};
+
+// A tile addressed through its chunk. Valid until the chunk is unloaded.
+struct TileRef
+{
+    Chunk *chunk = nullptr;
+    uint32_t tileIdx = 0;
+
+    bool operator==(const TileRef &other) const
+    {
+        return chunk == other.chunk && tileIdx == other.tileIdx;
+    }
 };
 
 inline uint64_t packChunkCoords(int32_t x, int32_t y)
@@ -40,6 +160,12 @@ inline int32_t floor_div(int32_t v, int32_t s)
     return (v >= 0) ? (v / s) : ((v - (s - 1)) / s);
 };
 
+// World positions are fractional, going through the int version would truncate them toward 0 first
+inline int32_t floor_div(float v, int32_t s)
+{
+    return (int32_t)std::floor(v / (float)s);
+}
+
 inline glm::vec2 worldPosToTilePos(glm::vec2 chunkPos, glm::vec2 pos)
 {
     glm::vec2 diff = pos - chunkPos;
@@ -65,3 +191,15 @@ static inline int32_t worldToTileCoord(float w)
 {
     return floor_div(w, TILE_WORLD_SIZE);
 }
+
+// Orders world positions by chunk first and by tile index inside the chunk second.
+// Chunk coordinates are biased into 24 bits each, tile index (see localIndexToTileIndex) takes the low 10 bits.
+inline uint64_t spatialSortKey(glm::vec2 pos)
+{
+    int32_t tileX = worldToTileCoord(pos.x);
+    int32_t tileY = worldToTileCoord(pos.y);
+    uint64_t chunkX = uint64_t(uint32_t((tileX >> CHUNK_SHIFT) + (1 << 23)) & 0xFFFFFF);
+    uint64_t chunkY = uint64_t(uint32_t((tileY >> CHUNK_SHIFT) + (1 << 23)) & 0xFFFFFF);
+    uint64_t tileIdx = (uint64_t)localIndexToTileIndex(tileX & CHUNK_MASK, tileY & CHUNK_MASK);
+    return (chunkX << 34) | (chunkY << 10) | tileIdx;
+}
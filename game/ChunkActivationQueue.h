@@ -0,0 +1,105 @@
+/**
+ * ChunkActivationQueue
+ *
+ * Chunks that entered or left the window but haven't been (de)activated yet. Activating a chunk pushes
+ * all its tiles and entities into the renderer, so doing every chunk of a window shift in one frame
+ * is a spike. drain() works through the queue under a time budget instead: activations first, nearest
+ * to the centre first, then deactivations. Chunks within mustActivateRadius of the centre are activated
+ * no matter the budget, the player can touch those.
+ *
+ * Only the latest wish per chunk is kept. A chunk that leaves and comes back before it was deactivated
+ * simply drops out of the queue.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include "../libs/ankerl/unordered_dense.h"
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+struct ChunkActivationQueue
+{
+    struct Pending
+    {
+        int64_t chunkIdx;
+        bool activate;
+        int32_t distance; // In chunks from the centre, Chebyshev
+    };
+
+    ankerl::unordered_dense::map<int64_t, bool> pending; // chunkIdx -> activate
+    std::vector<Pending> order;                          // Scratch for drain
+
+    void activate(int64_t chunkIdx)
+    {
+        request(chunkIdx, true);
+    }
+
+    void deactivate(int64_t chunkIdx)
+    {
+        request(chunkIdx, false);
+    }
+
+    size_t depth() const
+    {
+        return pending.size();
+    }
+
+    /**
+     * Applies queued requests until budgetMicros is used up, always at least one.
+     * apply: void(int64_t chunkIdx, bool activate)
+     */
+    template <typename Apply>
+    void drain(int32_t centerChunkX, int32_t centerChunkY, int32_t mustActivateRadius, uint32_t budgetMicros, Apply &&apply)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        if (pending.empty())
+            return;
+
+        order.clear();
+        for (auto &[chunkIdx, activate] : pending)
+        {
+            auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(chunkIdx);
+            int32_t distance = std::max(std::abs(chunkWorldX / CHUNK_WORLD_SIZE - centerChunkX),
+                                        std::abs(chunkWorldY / CHUNK_WORLD_SIZE - centerChunkY));
+            order.push_back({chunkIdx, activate, distance});
+        }
+        std::sort(order.begin(), order.end(), [](const Pending &a, const Pending &b) {
+            if (a.activate != b.activate)
+                return a.activate;
+            return a.distance < b.distance;
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        auto budget = std::chrono::microseconds(budgetMicros);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const Pending &next = order[i];
+            bool mustActivate = next.activate && next.distance <= mustActivateRadius;
+            if (i > 0 && !mustActivate && std::chrono::steady_clock::now() - start >= budget)
+                break;
+
+            apply(next.chunkIdx, next.activate);
+            pending.erase(next.chunkIdx);
+        }
+    }
+
+private:
+    void request(int64_t chunkIdx, bool activate)
+    {
+        auto it = pending.find(chunkIdx);
+        if (it != pending.end() && it->second != activate)
+            pending.erase(it); // Cancels out, the chunk is already in the state it wants to be in
+        else
+            pending[chunkIdx] = activate;
+    }
+};
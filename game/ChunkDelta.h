@@ -0,0 +1,105 @@
+/**
+ * ChunkDelta
+ *
+ * How far a chunk has been drilled, relative to what the generator makes of it. Tiles only ever lose
+ * health, so wear = generated health - current health is never negative, and a tile at zero health is
+ * empty. Untouched tiles have zero wear. That makes the delta a few long runs of zeros, which is what
+ * the (run length, wear) pairs below exploit.
+ *
+ * Used for the in memory snapshots of ChunkResidency and for the chunks in region files.
+ */
+
+#pragma once
+#include "CaveSystem.h"
+#include "Chunk.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+namespace ChunkDelta
+{
+    constexpr uint32_t MAX_RUN = 255;
+
+    /**
+     * Encodes the wear of current against generated into out. Returns false, leaving out empty, if the
+     * chunk has no wear at all.
+     */
+    inline bool encode(const uint8_t *generatedHealth, const uint8_t *currentHealth, std::vector<uint8_t> &out)
+    {
+        out.clear();
+        uint8_t wear[TILES_PER_CHUNK];
+        bool worn = false;
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
+        {
+            assert(currentHealth[tileIdx] <= generatedHealth[tileIdx] && "Tiles don't heal");
+            wear[tileIdx] = uint8_t(generatedHealth[tileIdx] - currentHealth[tileIdx]);
+            worn |= wear[tileIdx] != 0;
+        }
+        if (!worn)
+            return false;
+
+        uint32_t tileIdx = 0;
+        while (tileIdx < TILES_PER_CHUNK)
+        {
+            uint8_t value = wear[tileIdx];
+            uint32_t run = 1;
+            while (tileIdx + run < TILES_PER_CHUNK && run < MAX_RUN && wear[tileIdx + run] == value)
+                run++;
+            out.push_back((uint8_t)run);
+            out.push_back(value);
+            tileIdx += run;
+        }
+        return true;
+    }
+
+    /**
+     * Lays an encoded delta over the blueprint of the same chunk: worn tiles lose health, tiles worn down
+     * to zero become empty and lose their decoration. The data may come from disk, so all of it is
+     * validated first. A rejected delta throws and leaves the blueprint untouched.
+     */
+    inline void apply(const uint8_t *data, size_t size, ChunkBlueprint &blueprint)
+    {
+        if (size % 2 != 0)
+            throw std::runtime_error("corrupt chunk delta");
+
+        // --- Validate ---
+        uint32_t tileIdx = 0;
+        for (size_t i = 0; i < size; i += 2)
+        {
+            uint32_t run = data[i];
+            uint8_t wear = data[i + 1];
+            if (run == 0 || tileIdx + run > TILES_PER_CHUNK)
+                throw std::runtime_error("corrupt chunk delta");
+
+            for (uint32_t end = tileIdx + run; tileIdx < end; tileIdx++)
+            {
+                if (wear > blueprint.tileHealth[tileIdx])
+                    throw std::runtime_error("chunk delta doesn't match the generated chunk");
+            }
+        }
+
+        if (tileIdx != TILES_PER_CHUNK)
+            throw std::runtime_error("corrupt chunk delta");
+
+        // --- Apply ---
+        tileIdx = 0;
+        for (size_t i = 0; i < size; i += 2)
+        {
+            uint32_t run = data[i];
+            uint8_t wear = data[i + 1];
+            for (uint32_t end = tileIdx + run; tileIdx < end; tileIdx++)
+            {
+                if (wear == 0)
+                    continue;
+
+                blueprint.tileHealth[tileIdx] -= wear;
+                if (blueprint.tileHealth[tileIdx] == 0)
+                {
+                    blueprint.tileTypes[tileIdx] = TileType::Empty;
+                    blueprint.decorations[tileIdx] = {};
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * ChunkPool
+ *
+ * Fixed size slots for chunks in one reserved address range that is committed front to back as the
+ * pool fills up (see VirtualRange). A chunk never moves while it is loaded, so a Chunk pointer stays
+ * valid until that chunk is unloaded, and growing the pool copies nothing. Slots of unloaded chunks are
+ * reused first.
+ *
+ * EntityManager::chunks maps chunk coordinates to slots.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include "VirtualMemory.h"
+#include <vector>
+#include <new>
+
+constexpr uint32_t CHUNK_POOL_MAX_CHUNKS = 1 << 16; // About 270 MB of address space, nowhere near committed
+constexpr uint32_t CHUNK_POOL_COMMIT_STEP = 64;     // Chunks committed at a time
+
+struct ChunkPool
+{
+    VirtualRange range;
+    uint32_t slotCount = 0; // Every slot ever used is below this
+    uint32_t liveCount = 0;
+    std::vector<uint32_t> freeSlots;
+
+    ChunkPool() = default;
+    ChunkPool(const ChunkPool &) = delete;
+    ChunkPool &operator=(const ChunkPool &) = delete;
+
+    // Gives the address range back. Chunks still in the pool are not destructed, unload them first.
+    ~ChunkPool()
+    {
+        range.release();
+    }
+
+    Chunk &operator[](uint32_t slot)
+    {
+        assert(slot < slotCount);
+        return ((Chunk *)range.base)[slot];
+    }
+
+    const Chunk &operator[](uint32_t slot) const
+    {
+        assert(slot < slotCount);
+        return ((const Chunk *)range.base)[slot];
+    }
+
+    uint32_t acquire(int32_t chunkX, int32_t chunkY)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            if (slotCount == CHUNK_POOL_MAX_CHUNKS)
+                throw std::bad_alloc();
+            if (!range.base)
+                range.reserve(size_t(CHUNK_POOL_MAX_CHUNKS) * sizeof(Chunk));
+
+            slot = slotCount++;
+            uint32_t committedChunks = (slotCount + CHUNK_POOL_COMMIT_STEP - 1) / CHUNK_POOL_COMMIT_STEP * CHUNK_POOL_COMMIT_STEP;
+            range.commitTo(size_t(committedChunks) * sizeof(Chunk));
+        }
+
+        new ((Chunk *)range.base + slot) Chunk{chunkX, chunkY};
+        liveCount++;
+        return slot;
+    }
+
+    void release(uint32_t slot)
+    {
+        (*this)[slot].~Chunk();
+        freeSlots.push_back(slot);
+        liveCount--;
+    }
+
+    size_t committedBytes() const
+    {
+        return range.committedBytes;
+    }
+};
@@ -0,0 +1,221 @@
+/**
+ * ChunkResidency
+ *
+ * Keeps the chunks that stay in memory under a byte budget. Every resident chunk remembers when the
+ * player last had it in the active window. Once the budget is exceeded, the chunks visited least
+ * recently are evicted until usage is back under the low watermark. Chunks in the current window are
+ * never evicted.
+ *
+ * Generation is deterministic (see WorldRandom), so an evicted chunk that was never drilled is simply
+ * dropped and planned again when the player comes back. A chunk drilled since the last save leaves its
+ * ChunkDelta behind, restore() lays that over the freshly planned blueprint, so broken tiles and their
+ * overlays stay gone. Snapshots only live until the next save, after that RegionStore has them.
+ * Saves only encode the chunks drilled since the previous one (Chunk::unsaved), the rest is on disk.
+ */
+
+#pragma once
+#include "EntityManager.h"
+#include "CaveSystem.h"
+#include "ChunkDelta.h"
+#include "Chunk.h"
+#include "Globals.h"
+#include "../libs/ankerl/unordered_dense.h"
+#include <vector>
+#include <algorithm>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+const size_t CHUNK_MEMORY_BUDGET_BYTES = 64ull << 20;
+
+struct ChunkResidencyStats
+{
+    uint32_t residentChunks = 0;
+    size_t residentBytes = 0;
+    uint32_t snapshots = 0;   // Evicted chunks that were drilled
+    size_t snapshotBytes = 0;
+    uint64_t evicted = 0;     // Since start, snapshotted or dropped
+    uint64_t dropped = 0;     // Evicted without a snapshot
+    uint64_t restored = 0;    // Snapshots laid over a planned chunk again
+};
+
+struct ChunkResidency
+{
+    struct Resident
+    {
+        uint64_t lastVisit = 0;
+        size_t bytes = 0;
+    };
+
+    size_t budgetBytes = CHUNK_MEMORY_BUDGET_BYTES;
+    float lowWatermark = 0.75f; // Eviction stops at this fraction of budgetBytes
+
+    ankerl::unordered_dense::map<int64_t, Resident> residents;
+    ankerl::unordered_dense::map<int64_t, std::vector<uint8_t>> snapshots;
+    uint64_t clock = 1;
+    ChunkResidencyStats counters;
+    size_t residentBytes = 0;
+    size_t snapshotBytes = 0;
+    std::vector<std::pair<uint64_t, int64_t>> candidates; // (lastVisit, chunkIdx), reused between evictions
+
+    // Starts tracking a chunk that was just committed
+    void track(int64_t chunkIdx, size_t bytes)
+    {
+        auto [it, inserted] = residents.try_emplace(chunkIdx, Resident{clock, bytes});
+        assert(inserted && "Chunk is already resident");
+        residentBytes += bytes;
+    }
+
+    // The chunk is in the active window this frame. Also refreshes its size, arenas grow as entities are placed.
+    void visit(int64_t chunkIdx, size_t bytes)
+    {
+        Resident &resident = residents.at(chunkIdx);
+        residentBytes = residentBytes - resident.bytes + bytes;
+        resident.bytes = bytes;
+        resident.lastVisit = clock;
+    }
+
+    /**
+     * Lays the snapshot of an evicted chunk over its freshly planned blueprint, if there is one.
+     * Returns true if it did, the committed chunk then counts as unsaved again.
+     */
+    bool restore(int64_t chunkIdx, ChunkBlueprint &blueprint)
+    {
+        auto it = snapshots.find(chunkIdx);
+        if (it == snapshots.end())
+            return false;
+
+        ChunkDelta::apply(it->second.data(), it->second.size(), blueprint);
+        snapshotBytes -= it->second.capacity();
+        snapshots.erase(it);
+        counters.restored++;
+        return true;
+    }
+
+    /**
+     * Evicts least recently visited chunks while over budget and advances the clock. Call once per frame,
+     * after the window's chunks were visited and when nothing holds on to a Chunk or TileRef.
+     * Returns how many chunks were evicted.
+     */
+    uint32_t evictOverBudget()
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        uint64_t now = clock++;
+        if (residentBytes <= budgetBytes)
+            return 0;
+
+        // Chunks that left the window may still wait for their deactivation, see ChunkActivationQueue
+        candidates.clear();
+        for (auto &[chunkIdx, resident] : residents)
+            if (resident.lastVisit < now && ecs->getChunk(chunkIdx).renderSlot == UINT32_MAX)
+                candidates.emplace_back(resident.lastVisit, chunkIdx);
+        std::sort(candidates.begin(), candidates.end());
+
+        size_t target = size_t(double(budgetBytes) * lowWatermark);
+        uint32_t evicted = 0;
+        for (auto &[lastVisit, chunkIdx] : candidates)
+        {
+            if (residentBytes <= target)
+                break;
+            evict(chunkIdx);
+            evicted++;
+        }
+        return evicted;
+    }
+
+    ChunkResidencyStats stats() const
+    {
+        ChunkResidencyStats out = counters;
+        out.residentChunks = (uint32_t)residents.size();
+        out.residentBytes = residentBytes;
+        out.snapshots = (uint32_t)snapshots.size();
+        out.snapshotBytes = snapshotBytes;
+        return out;
+    }
+
+    /**
+     * Collects the delta of every chunk drilled since the last save into out, keyed by chunk index: the
+     * snapshots of evicted chunks and the resident chunks that are unsaved. Chunks saved before are left
+     * out, their region file already has them. Nothing is forgotten until markSaved, so a failed save
+     * loses nothing.
+     */
+    void collectUnsaved(ankerl::unordered_dense::map<int64_t, std::vector<uint8_t>> &out)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        for (auto &[chunkIdx, snapshot] : snapshots)
+            out[chunkIdx] = snapshot;
+
+        for (auto &[chunkIdx, resident] : residents)
+        {
+            const Chunk &chunk = ecs->getChunk(chunkIdx);
+            if (!chunk.unsaved)
+                continue;
+
+            // An empty delta is a valid save too, the chunk is what the generator makes
+            std::vector<uint8_t> delta;
+            encodeDelta(chunk, delta);
+            out[chunkIdx] = std::move(delta);
+        }
+    }
+
+    // The deltas from collectUnsaved are on disk now
+    void markSaved(const ankerl::unordered_dense::map<int64_t, std::vector<uint8_t>> &saved)
+    {
+        for (auto &[chunkIdx, delta] : saved)
+        {
+            auto snapshot = snapshots.find(chunkIdx);
+            if (snapshot != snapshots.end())
+            {
+                snapshotBytes -= snapshot->second.capacity();
+                snapshots.erase(snapshot);
+            }
+            else if (residents.contains(chunkIdx))
+            {
+                ecs->getChunk(chunkIdx).unsaved = false;
+            }
+        }
+    }
+
+private:
+    void evict(int64_t chunkIdx)
+    {
+        auto resident = residents.find(chunkIdx);
+        assert(resident != residents.end());
+
+        Chunk &chunk = ecs->getChunk(chunkIdx);
+        assert(chunk.renderSlot == UINT32_MAX && "Deactivate the chunk before evicting it");
+        // A chunk saved since it was last drilled is restored from its region file instead
+        std::vector<uint8_t> delta;
+        if (chunk.unsaved && encodeDelta(chunk, delta))
+        {
+            delta.shrink_to_fit();
+            snapshotBytes += delta.capacity();
+            snapshots[chunkIdx] = std::move(delta);
+        }
+        else
+        {
+            counters.dropped++;
+        }
+
+        ecs->unloadChunk(chunkIdx);
+        residentBytes -= resident->second.bytes;
+        residents.erase(resident);
+        counters.evicted++;
+    }
+
+    // Plans the chunk again to have something to diff against, about as expensive as a chunk load
+    bool encodeDelta(const Chunk &chunk, std::vector<uint8_t> &out)
+    {
+        ChunkBlueprint &generated = caveSystem->scratchBlueprint;
+        caveSystem->planWorldChunk(chunk.chunkX, chunk.chunkY, generated);
+        return ChunkDelta::encode(generated.tileHealth, chunk.tileHealth, out);
+    }
+};
@@ -0,0 +1,161 @@
+/**
+ * ChunkStreamer
+ *
+ * Plans chunks on worker threads so that the main thread only has to commit them. Requests go in
+ * through request(), finished blueprints come back through collect(). Workers only ever call
+ * CaveSystem::planWorldChunk, which does not touch the ECS.
+ */
+
+#pragma once
+#include "CaveSystem.h"
+#include "../libs/ankerl/unordered_dense.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+struct ChunkStreamer
+{
+    const CaveSystem *caves = nullptr;
+    std::vector<std::thread> workers;
+
+    // --- Shared with workers, guarded by mutex ---
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<int64_t> requests;
+    std::vector<std::unique_ptr<ChunkBlueprint>> finished;
+    std::vector<std::unique_ptr<ChunkBlueprint>> spare; // Recycled blueprints, they're big
+    bool stopping = false;
+
+    // --- Main thread only ---
+    ankerl::unordered_dense::set<int64_t> inFlight;
+
+    ~ChunkStreamer()
+    {
+        stop();
+    }
+
+    void start(const CaveSystem *caveSystem, uint32_t workerCount)
+    {
+        caves = caveSystem;
+        for (uint32_t i = 0; i < workerCount; i++)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    // Joins the workers. Safe to call more than once, the destructor calls it too.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    // Queues a chunk unless it's already queued or being planned. Requests are served in order, see prune.
+    void request(int64_t chunkIdx)
+    {
+        if (!inFlight.insert(chunkIdx).second)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(chunkIdx);
+        }
+        wake.notify_one();
+    }
+
+    /**
+     * Drops queued requests for chunks more than keepDistance chunks away from (cx, cy), the same
+     * distance the main thread throws planned chunks away at. Chunks a worker already picked up are
+     * left alone.
+     */
+    void prune(int32_t cx, int32_t cy, int32_t keepDistance)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::erase_if(requests, [&](int64_t chunkIdx) {
+            auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(chunkIdx);
+            int32_t distX = std::abs(chunkWorldX - cx) / CHUNK_WORLD_SIZE;
+            int32_t distY = std::abs(chunkWorldY - cy) / CHUNK_WORLD_SIZE;
+            if (std::max(distX, distY) <= keepDistance)
+                return false;
+            inFlight.erase(chunkIdx);
+            return true;
+        });
+    }
+
+    bool isInFlight(int64_t chunkIdx) const
+    {
+        return inFlight.contains(chunkIdx);
+    }
+
+    // Moves every finished blueprint to out
+    void collect(std::vector<std::unique_ptr<ChunkBlueprint>> &out)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::unique_ptr<ChunkBlueprint> &blueprint : finished)
+                out.push_back(std::move(blueprint));
+            finished.clear();
+        }
+
+        for (size_t i = 0; i < out.size(); i++)
+            inFlight.erase(packChunkCoords(out[i]->chunkX, out[i]->chunkY));
+    }
+
+    // Hands a blueprint back for reuse once it has been committed or dropped
+    void recycle(std::unique_ptr<ChunkBlueprint> blueprint)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        spare.push_back(std::move(blueprint));
+    }
+
+private:
+    void workerLoop([[maybe_unused]] uint32_t workerIdx)
+    {
+        #ifdef _DEBUG
+        std::string threadName = "ChunkWorker" + std::to_string(workerIdx);
+        tracy::SetThreadName(threadName.c_str());
+        #endif
+
+        while (true)
+        {
+            int64_t chunkIdx;
+            std::unique_ptr<ChunkBlueprint> blueprint;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+
+                chunkIdx = requests.front();
+                requests.pop_front();
+                if (!spare.empty())
+                {
+                    blueprint = std::move(spare.back());
+                    spare.pop_back();
+                }
+            }
+
+            if (!blueprint)
+                blueprint = std::make_unique<ChunkBlueprint>();
+
+            auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(chunkIdx);
+            caves->planWorldChunk(chunkWorldX, chunkWorldY, *blueprint);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(std::move(blueprint));
+            }
+        }
+    }
+};
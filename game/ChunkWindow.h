@@ -0,0 +1,139 @@
+/**
+ * ChunkWindow
+ *
+ * The chunks around the player, as a toroidal 8x8 array of Chunk pointers. A chunk sits in slot
+ * (chunkX & 7, chunkY & 7), so finding the chunk of a tile is a shift and two masks, with no hashing.
+ * Every slot remembers which chunk it holds, so slots left over from an old centre never answer
+ * for the wrong chunk. Chunks don't move while loaded (see ChunkPool), so a slot stays valid for as
+ * long as its chunk is in the window.
+ *
+ * Only chunks inside the active window (CHUNK_WINDOW_RADIUS around the centre) are in it. Anything
+ * else goes through EntityManager::chunks, which is there for residency.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <algorithm>
+
+constexpr int32_t CHUNK_WINDOW_RADIUS = 2; // 5x5 chunks, see Game::handleChunkLifecycle
+constexpr int32_t CHUNK_WINDOW_SHIFT = 3;
+constexpr int32_t CHUNK_WINDOW_SIDE = 1 << CHUNK_WINDOW_SHIFT;
+constexpr int32_t CHUNK_WINDOW_MASK = CHUNK_WINDOW_SIDE - 1;
+static_assert(2 * CHUNK_WINDOW_RADIUS + 1 <= CHUNK_WINDOW_SIDE, "Window doesn't fit the ring");
+
+// Chunk coordinate (in chunks, not world units) of a world position or tile coordinate
+inline int32_t worldToChunkCoord(float w)
+{
+    return floor_div(w, CHUNK_WORLD_SIZE);
+}
+
+inline int32_t tileToChunkCoord(int32_t tile)
+{
+    return tile >> CHUNK_SHIFT;
+}
+
+struct ChunkWindow
+{
+    struct Slot
+    {
+        int32_t chunkX = INT32_MIN;
+        int32_t chunkY = INT32_MIN;
+        Chunk *chunk = nullptr;
+    };
+
+    Slot slots[CHUNK_WINDOW_SIDE * CHUNK_WINDOW_SIDE];
+    int32_t centerX = 0;
+    int32_t centerY = 0;
+
+    static uint32_t slotIndex(int32_t chunkX, int32_t chunkY)
+    {
+        return uint32_t(((chunkX & CHUNK_WINDOW_MASK) << CHUNK_WINDOW_SHIFT) | (chunkY & CHUNK_WINDOW_MASK));
+    }
+
+    // Null if the chunk is not in the window
+    Chunk *find(int32_t chunkX, int32_t chunkY) const
+    {
+        const Slot &slot = slots[slotIndex(chunkX, chunkY)];
+        return (slot.chunkX == chunkX && slot.chunkY == chunkY) ? slot.chunk : nullptr;
+    }
+
+    // Without chunk if the tile's chunk is not in the window
+    TileRef tileAt(int32_t tileX, int32_t tileY) const
+    {
+        Chunk *chunk = find(tileToChunkCoord(tileX), tileToChunkCoord(tileY));
+        if (!chunk)
+            return {};
+        return {chunk, (uint32_t)localIndexToTileIndex(tileX & CHUNK_MASK, tileY & CHUNK_MASK)};
+    }
+
+    /**
+     * True if any tile in the inclusive tile rectangle is solid, going by Chunk::solidMask. Chunks that
+     * are not in the window count as solid: nothing should move, shine or path into them.
+     */
+    bool anySolid(int32_t tileX0, int32_t tileY0, int32_t tileX1, int32_t tileY1) const
+    {
+        assert(tileX0 <= tileX1 && tileY0 <= tileY1);
+        for (int32_t chunkX = tileToChunkCoord(tileX0); chunkX <= tileToChunkCoord(tileX1); chunkX++)
+        {
+            for (int32_t chunkY = tileToChunkCoord(tileY0); chunkY <= tileToChunkCoord(tileY1); chunkY++)
+            {
+                Chunk *chunk = find(chunkX, chunkY);
+                if (!chunk)
+                    return true;
+
+                int32_t firstTileX = chunkX << CHUNK_SHIFT;
+                int32_t firstTileY = chunkY << CHUNK_SHIFT;
+                int32_t localX0 = std::max(tileX0 - firstTileX, 0);
+                int32_t localY0 = std::max(tileY0 - firstTileY, 0);
+                int32_t localX1 = std::min(tileX1 - firstTileX, TILES_PER_ROW - 1);
+                int32_t localY1 = std::min(tileY1 - firstTileY, TILES_PER_ROW - 1);
+                if (chunk->anySolid(localX0, localY0, localX1, localY1))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Moves the window to the given centre chunk. Slots that stay in the window are kept, the new ones
+     * get their chunk from lookup: Chunk *(int32_t chunkX, int32_t chunkY).
+     */
+    template <typename Lookup>
+    void recenter(int32_t newCenterX, int32_t newCenterY, Lookup &&lookup)
+    {
+        centerX = newCenterX;
+        centerY = newCenterY;
+
+        for (Slot &slot : slots)
+        {
+            if (!slot.chunk)
+                continue;
+            bool inWindow = std::abs(slot.chunkX - centerX) <= CHUNK_WINDOW_RADIUS
+                && std::abs(slot.chunkY - centerY) <= CHUNK_WINDOW_RADIUS;
+            if (!inWindow)
+                slot = {};
+        }
+
+        for (int32_t chunkX = centerX - CHUNK_WINDOW_RADIUS; chunkX <= centerX + CHUNK_WINDOW_RADIUS; chunkX++)
+        {
+            for (int32_t chunkY = centerY - CHUNK_WINDOW_RADIUS; chunkY <= centerY + CHUNK_WINDOW_RADIUS; chunkY++)
+            {
+                Slot &slot = slots[slotIndex(chunkX, chunkY)];
+                if (slot.chunk)
+                    continue;
+
+                slot = {chunkX, chunkY, lookup(chunkX, chunkY)};
+                assert(slot.chunk);
+            }
+        }
+    }
+
+    void clear()
+    {
+        for (Slot &slot : slots)
+            slot = {};
+    }
+};
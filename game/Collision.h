@@ -16,13 +16,13 @@ inline AABB computeWorldAABB(const Mesh &mesh, const Transform &t)
     glm::vec2 min(FLT_MAX), max(-FLT_MAX);
 
     const auto &verts = MeshRegistry::getVertices(mesh);
-    const glm::mat4 &m = t.model;
+    const Affine2 &m = t.model;
 
     for (size_t i = mesh.vertexOffset; i < mesh.vertexOffset + mesh.vertexCount; i++)
     {
         auto v = verts[i];
-        float x = v.pos.x * m[0][0] + v.pos.y * m[1][0] + m[3][0];
-        float y = v.pos.x * m[0][1] + v.pos.y * m[1][1] + m[3][1];
+        float x = v.pos.x * m.col0.x + v.pos.y * m.col1.x + m.translation.x;
+        float y = v.pos.x * m.col0.y + v.pos.y * m.col1.y + m.translation.y;
 
         min.x = std::min(min.x, x);
         min.y = std::min(min.y, y);
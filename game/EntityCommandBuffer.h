@@ -0,0 +1,213 @@
+/**
+ * EntityCommandBuffer
+ *
+ * Records structural changes to the ECS (create, destroy, push and erase of components) while systems
+ * are iterating, and applies all of them at one sync point with flush().
+ *
+ * A flush runs in a fixed order: creates, component ops, destroys. Every step is grouped per component
+ * store and sorted by entity index, so each store is grown or compacted once per flush instead of once
+ * per command.
+ *
+ * Pushes and erases of one component go into one list, so for every entity only its last op on that
+ * component counts: erase then push leaves the entity with the component, push then erase without it,
+ * and of two pushes the later one wins. A push for an entity that already has the component overwrites
+ * it. Ops on entities that died before the flush are dropped.
+ */
+
+#pragma once
+#include "EntityManager.h"
+#include <vector>
+#include <tuple>
+#include <algorithm>
+
+struct PendingCreate
+{
+    Entity entity;
+    SpatialStorage spatialStorage;
+    int64_t chunkIdx;
+    EntityDesc desc;
+};
+
+enum class ComponentOp : uint8_t
+{
+    Push,
+    Erase,
+};
+
+template <typename T>
+struct PendingComponentOp
+{
+    Entity entity;
+    ComponentOp op;
+    T component; // Unused for erases
+};
+
+template <typename T>
+struct ComponentCommandQueue
+{
+    std::vector<PendingComponentOp<T>> ops; // In recording order until flushed
+};
+
+template <typename Stores>
+struct ComponentCommandQueues;
+
+template <typename... Ts>
+struct ComponentCommandQueues<std::tuple<ComponentStorage<Ts>...>>
+{
+    using type = std::tuple<ComponentCommandQueue<Ts>...>;
+};
+
+struct EntityCommandBuffer
+{
+    std::vector<PendingCreate> creates;
+    std::vector<Entity> destroys[(size_t)SpatialStorage::COUNT];
+    ComponentCommandQueues<ComponentStores>::type queues;
+
+    // Scratch space for flush
+    std::vector<EntityDesc> descScratch;
+    std::vector<Entity> entityScratch;
+    std::vector<uint32_t> indexScratch;
+    std::vector<uint32_t> opScratch;
+
+    // The entity id is handed out right away so the caller can record pushes against it,
+    // but none of its components exist before the next flush.
+    Entity create(EntityManager &ecs, const EntityDesc &desc, const SpatialStorage &spatialStorage)
+    {
+        Entity entity = ecs.allocateEntity();
+        int64_t chunkIdx = packChunkCoords(
+            worldPosToClosestChunk(desc.transform.position.x),
+            worldPosToClosestChunk(desc.transform.position.y));
+        creates.push_back({entity, spatialStorage, chunkIdx, desc});
+        return entity;
+    }
+
+    void destroy(Entity entity, const SpatialStorage &spatialStorage)
+    {
+        destroys[(size_t)spatialStorage].push_back(entity);
+    }
+
+    template <typename T>
+    void push(Entity entity, const T &component)
+    {
+        std::get<ComponentCommandQueue<T>>(queues).ops.push_back({entity, ComponentOp::Push, component});
+    }
+
+    template <typename T>
+    void erase(Entity entity)
+    {
+        std::get<ComponentCommandQueue<T>>(queues).ops.push_back({entity, ComponentOp::Erase, T{}});
+    }
+
+    void flush(EntityManager &ecs)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        flushCreates(ecs);
+        std::apply([&](auto &...queue) { (flushOps(ecs, queue), ...); }, queues);
+
+        for (size_t i = 0; i < (size_t)SpatialStorage::COUNT; i++)
+        {
+            if (destroys[i].empty())
+                continue;
+
+            ecs.destroyEntities(destroys[i], (SpatialStorage)i);
+            destroys[i].clear();
+        }
+    }
+
+private:
+    void flushCreates(EntityManager &ecs)
+    {
+        if (creates.empty())
+            return;
+
+        // Group by spatial storage and chunk so that each run can go through buildEntities
+        std::sort(creates.begin(), creates.end(), [](const PendingCreate &a, const PendingCreate &b) {
+            if (a.spatialStorage != b.spatialStorage)
+                return a.spatialStorage < b.spatialStorage;
+            if (a.chunkIdx != b.chunkIdx)
+                return a.chunkIdx < b.chunkIdx;
+            return entityIndex(a.entity) < entityIndex(b.entity);
+        });
+
+        size_t runStart = 0;
+        while (runStart < creates.size())
+        {
+            size_t runEnd = runStart + 1;
+            while (runEnd < creates.size() &&
+                   creates[runEnd].spatialStorage == creates[runStart].spatialStorage &&
+                   (creates[runEnd].spatialStorage == SpatialStorage::Global || creates[runEnd].chunkIdx == creates[runStart].chunkIdx))
+                runEnd++;
+
+            descScratch.clear();
+            entityScratch.clear();
+            for (size_t i = runStart; i < runEnd; i++)
+            {
+                descScratch.push_back(creates[i].desc);
+                entityScratch.push_back(creates[i].entity);
+            }
+            ecs.buildEntities(descScratch, creates[runStart].spatialStorage, entityScratch.data());
+
+            runStart = runEnd;
+        }
+
+        creates.clear();
+    }
+
+    template <typename T>
+    void flushOps(EntityManager &ecs, ComponentCommandQueue<T> &queue)
+    {
+        if (queue.ops.empty())
+            return;
+
+        // Stable, so the ops of one entity stay in recording order and the last one of each run wins
+        std::stable_sort(queue.ops.begin(), queue.ops.end(), [](const PendingComponentOp<T> &a, const PendingComponentOp<T> &b) {
+            return entityIndex(a.entity) < entityIndex(b.entity);
+        });
+
+        // --- Resolve to one op per entity ---
+        indexScratch.clear(); // Entities to erase T from
+        opScratch.clear();    // Ops whose entity gets T pushed
+        size_t count = queue.ops.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i + 1 < count && entityIndex(queue.ops[i + 1].entity) == entityIndex(queue.ops[i].entity))
+                continue;
+
+            const PendingComponentOp<T> &last = queue.ops[i];
+            if (!ecs.isAlive(last.entity))
+                continue;
+
+            uint32_t entityIdx = entityIndex(last.entity);
+            bool hasComponent = ecs.signatures[entityIdx] & componentMask<T>();
+            if (last.op == ComponentOp::Erase)
+            {
+                if (hasComponent)
+                    indexScratch.push_back(entityIdx);
+            }
+            else if (hasComponent)
+            {
+                ecs.at<T>(entityIdx) = last.component;
+                if constexpr (ComponentTraits<T>::trackChanges)
+                    ecs.markChanged<T>(last.entity);
+            }
+            else
+            {
+                opScratch.push_back((uint32_t)i);
+            }
+        }
+
+        ecs.eraseMany<T>(indexScratch.data(), (uint32_t)indexScratch.size());
+
+        indexScratch.clear();
+        for (uint32_t op : opScratch)
+            indexScratch.push_back(entityIndex(queue.ops[op].entity));
+        ecs.pushRange<T>(indexScratch.data(), (uint32_t)indexScratch.size(), [&](uint32_t i) {
+            return queue.ops[opScratch[i]].component;
+        });
+
+        queue.ops.clear();
+    }
+};
@@ -4,32 +4,50 @@
 #include "components/AABB.h"
 #include "components/Mesh.h"
 #include "components/Entity.h"
-#include "components/Health.h"
-#include "components/Ground.h"
-#include "components/GroundCosmetic.h"
 #include "components/EntityType.h"
 #include "components/Renderable.h"
 #include "components/Material.h"
 #include "components/GroundOre.h"
+#include "components/UvTransform.h"
+#include "components/TransformMeta.h"
 #include "Collision.h"
 #include "DrawCmd.h"
 #include "TextureComponent.h"
 #include "../libs/ankerl/unordered_dense.h"
 #include "Chunk.h"
+#include "ChunkWindow.h"
+#include "ChunkPool.h"
 #include "SnakeMath.h"
+#include "VirtualMemory.h"
 #include <cstdint>
 #include <functional>
 #include <stack>
 #include <queue>
 #include <utility>
+#include <tuple>
+#include <span>
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
 
 constexpr uint32_t MAX_SEARCH_ITERATIONS_ATTEMPTS = UINT32_MAX / 2;
 
+// Entity indices are 24 bits, see entityIndex
+constexpr uint32_t MAX_ENTITIES = 1u << 24;
+
+// When set, the dense ComponentStorage arrays reserve address space for MAX_ENTITIES up front and commit
+// pages on demand. Growing then never copies, and pointers into the arrays stay valid.
+// When unset, the arrays are malloc'ed and copied on growth.
+constexpr bool ECS_RESERVE_AND_COMMIT = true;
+
+// Defragmentation sorts overlapping windows of 2 * ECS_DEFRAG_BLOCK components at a time
+constexpr uint32_t ECS_DEFRAG_BLOCK = 1024;
+
 enum class SpatialStorage : uint32_t
 {
     Global,
     Chunk,
-    ChunkTile,
+    COUNT,
 };
 
 enum class ComponentId : uint16_t
@@ -41,200 +59,950 @@ enum class ComponentId : uint16_t
     Material,
     UvTransform,
     EntityType,
-    Health,
-    Ground,
-    GroundCosmetic,
     GroundOre,
+    TransformMeta,
     COUNT,
 };
 
+static constexpr const char *COMPONENT_NAMES[(size_t)ComponentId::COUNT] = {
+    "AABB",
+    "Transform",
+    "Mesh",
+    "Renderable",
+    "Material",
+    "UvTransform",
+    "EntityType",
+    "GroundOre",
+    "TransformMeta",
+};
+
+// One bit per ComponentId, stored per entity so queries can reject an entity without probing every store.
+using ComponentMask = uint32_t;
+static_assert((size_t)ComponentId::COUNT <= sizeof(ComponentMask) * 8, "ComponentMask is too small for ComponentId::COUNT");
+
+// --- Compile time mapping from component type to ComponentId ---
+// trackChanges: the storage keeps a list of entities whose component was modified, see markChanged.
+template <typename T> struct ComponentTraits;
+template <> struct ComponentTraits<AABB> { static constexpr ComponentId id = ComponentId::AABB; static constexpr bool trackChanges = false; };
+template <> struct ComponentTraits<Transform> { static constexpr ComponentId id = ComponentId::Transform; static constexpr bool trackChanges = true; };
+template <> struct ComponentTraits<Mesh> { static constexpr ComponentId id = ComponentId::Mesh; static constexpr bool trackChanges = false; };
+template <> struct ComponentTraits<Renderable> { static constexpr ComponentId id = ComponentId::Renderable; static constexpr bool trackChanges = false; };
+template <> struct ComponentTraits<Material> { static constexpr ComponentId id = ComponentId::Material; static constexpr bool trackChanges = true; };
+template <> struct ComponentTraits<UvTransform> { static constexpr ComponentId id = ComponentId::UvTransform; static constexpr bool trackChanges = true; };
+template <> struct ComponentTraits<EntityType> { static constexpr ComponentId id = ComponentId::EntityType; static constexpr bool trackChanges = false; };
+template <> struct ComponentTraits<GroundOre> { static constexpr ComponentId id = ComponentId::GroundOre; static constexpr bool trackChanges = false; };
+template <> struct ComponentTraits<TransformMeta> { static constexpr ComponentId id = ComponentId::TransformMeta; static constexpr bool trackChanges = false; };
+
+template <typename... Ts>
+constexpr ComponentMask componentMask()
+{
+    return ((ComponentMask(1) << (uint32_t)ComponentTraits<Ts>::id) | ... | ComponentMask(0));
+}
+
+// --- Paged sparse set ---
+// Entity -> dense lookups go through a page table. Pages are allocated when the first entity of the page
+// gets the component and freed again when the last one loses it. Every empty page points at one shared,
+// read only page full of SENTINEL, so a lookup never has to check for a missing page.
+constexpr uint32_t SPARSE_PAGE_SHIFT = 12;
+constexpr uint32_t SPARSE_PAGE_SIZE = 1u << SPARSE_PAGE_SHIFT; // Entries per page
+constexpr uint32_t SPARSE_PAGE_MASK = SPARSE_PAGE_SIZE - 1;
+constexpr uint32_t SPARSE_PAGE_COUNT = MAX_ENTITIES >> SPARSE_PAGE_SHIFT;
+
+inline uint32_t *sparseEmptyPage()
+{
+    static uint32_t *page = [] {
+        uint32_t *p = (uint32_t *)malloc(SPARSE_PAGE_SIZE * sizeof(uint32_t));
+        if (!p)
+            throw std::bad_alloc();
+        std::memset(p, 0xFF, SPARSE_PAGE_SIZE * sizeof(uint32_t));
+        return p;
+    }();
+    return page;
+}
+
+// Reused between defragmentation steps so they don't allocate
+struct DefragScratch
+{
+    std::vector<std::pair<uint64_t, uint32_t>> keyed; // (sort key, offset inside window)
+    std::vector<uint8_t> components;
+    std::vector<uint32_t> entities;
+};
+
+template <typename T>
 struct ComponentStorage {
+    static_assert(std::is_trivially_copyable_v<T>, "Components are moved around with memcpy");
+
     // --- Dense ---
-    uint8_t *denseBytes = nullptr;
+    T *dense = nullptr;
     uint32_t denseSize = 0;
     uint32_t denseCapacity = 0;
 
-    // --- Entity -> Dense ---
-    uint32_t *entityToDense = nullptr;
-    uint32_t  entityToDenseCapacity = 0;
+    // --- Entity -> Dense (paged, see sparseEmptyPage) ---
+    uint32_t **pages = nullptr;       // SPARSE_PAGE_COUNT entries
+    uint16_t *pageUsage = nullptr;    // Mapped entities per page
+    uint32_t allocatedPages = 0;
 
     // --- Dense -> Entity ---
     uint32_t *denseToEntity = nullptr;
-    
-    // --- Component ---
-    ComponentId componentId;
-    uint32_t componentSize;
 
+    // --- Backing memory (ECS_RESERVE_AND_COMMIT) ---
+    VirtualRange denseRange;
+    VirtualRange denseToEntityRange;
+
+    // --- Change tracking (ComponentTraits<T>::trackChanges) ---
+    std::vector<uint32_t> changed;      // entity indices modified since the last clearChanges
+    std::vector<uint8_t> changedFlags;  // per entity index, keeps `changed` free of duplicates
+
+    // --- Defragmentation ---
+    uint32_t defragCursor = 0;
+    uint32_t defragCleanRun = 0; // Components seen in order since the last reorder or structural change
+
+    using Component = T;
+    static constexpr ComponentId componentId = ComponentTraits<T>::id;
     static constexpr uint32_t SENTINEL = UINT32_MAX;
     static constexpr uint32_t MEM_CHUNK_SIZE = 0x10000;
 
-    ComponentStorage(ComponentId componentId, uint32_t componentSize): componentId(componentId), componentSize(componentSize) {
-        growDense();
-        growEntityToDense(1024);
+    ComponentStorage() {
+        growDense(1);
+
+        pages = (uint32_t **)malloc(SPARSE_PAGE_COUNT * sizeof(uint32_t *));
+        pageUsage = (uint16_t *)calloc(SPARSE_PAGE_COUNT, sizeof(uint16_t));
+        if (!pages || !pageUsage)
+            throw std::bad_alloc();
+        uint32_t *emptyPage = sparseEmptyPage();
+        for (uint32_t i = 0; i < SPARSE_PAGE_COUNT; i++)
+            pages[i] = emptyPage;
+    }
+
+    ~ComponentStorage() {
+        uint32_t *emptyPage = sparseEmptyPage();
+        for (uint32_t i = 0; i < SPARSE_PAGE_COUNT; i++)
+            if (pages[i] != emptyPage)
+                free(pages[i]);
+        free(pages);
+        free(pageUsage);
+
+        if constexpr (ECS_RESERVE_AND_COMMIT)
+        {
+            denseRange.release();
+            denseToEntityRange.release();
+        }
+        else
+        {
+            free(dense);
+            free(denseToEntity);
+        }
+    }
+
+    // Owns its memory, see the destructor
+    ComponentStorage(const ComponentStorage &) = delete;
+    ComponentStorage &operator=(const ComponentStorage &) = delete;
+
+    uint32_t denseIndexOf(uint32_t entityIdx) const
+    {
+        assert(entityIdx < MAX_ENTITIES);
+        return pages[entityIdx >> SPARSE_PAGE_SHIFT][entityIdx & SPARSE_PAGE_MASK];
+    }
+
+    // Points entityIdx at denseIdx, allocating the page if this is the first entity on it
+    void mapEntity(uint32_t entityIdx, uint32_t denseIdx)
+    {
+        assert(entityIdx < MAX_ENTITIES);
+        uint32_t pageIdx = entityIdx >> SPARSE_PAGE_SHIFT;
+        uint32_t *page = pages[pageIdx];
+        if (page == sparseEmptyPage())
+        {
+            page = (uint32_t *)malloc(SPARSE_PAGE_SIZE * sizeof(uint32_t));
+            if (!page)
+                throw std::bad_alloc();
+            std::memset(page, 0xFF, SPARSE_PAGE_SIZE * sizeof(uint32_t));
+            pages[pageIdx] = page;
+            allocatedPages++;
+        }
+
+        uint32_t &slot = page[entityIdx & SPARSE_PAGE_MASK];
+        if (slot == SENTINEL)
+            pageUsage[pageIdx]++;
+        slot = denseIdx;
+    }
+
+    // Drops the mapping and hands the page back once nothing on it is mapped anymore
+    void unmapEntity(uint32_t entityIdx)
+    {
+        uint32_t pageIdx = entityIdx >> SPARSE_PAGE_SHIFT;
+        uint32_t *page = pages[pageIdx];
+        assert(page != sparseEmptyPage());
+        assert(page[entityIdx & SPARSE_PAGE_MASK] != SENTINEL);
+        page[entityIdx & SPARSE_PAGE_MASK] = SENTINEL;
+
+        assert(pageUsage[pageIdx] > 0);
+        if (--pageUsage[pageIdx] == 0)
+        {
+            free(page);
+            pages[pageIdx] = sparseEmptyPage();
+            allocatedPages--;
+        }
+    }
+
+    // Memory held by the entity -> dense lookup
+    size_t sparseBytes() const
+    {
+        return SPARSE_PAGE_COUNT * (sizeof(uint32_t *) + sizeof(uint16_t)) +
+               size_t(allocatedPages) * SPARSE_PAGE_SIZE * sizeof(uint32_t);
     }
 
-    uint8_t *push(const void *src, uint32_t entityIdx)
+    T *push(const T &src, uint32_t entityIdx)
     {
         // --- Dense ---
         if (denseSize == denseCapacity) {
-            growDense();
+            growDense(denseSize + 1);
         }
         uint32_t denseIdx = denseSize;
-        void *dst = denseBytes + size_t(denseIdx * componentSize);
-        memcpy(dst, src, componentSize);
+        T *dst = dense + denseIdx;
+        memcpy(dst, &src, sizeof(T));
         denseToEntity[denseIdx] = entityIdx;
         
         // --- Entity -> Dense ---
-        if (entityIdx >= entityToDenseCapacity) {
-            growEntityToDense(entityIdx + 1);
-        }
-        entityToDense[entityIdx] = denseIdx;
+        assert(denseIndexOf(entityIdx) == SENTINEL);
+        mapEntity(entityIdx, denseIdx);
 
         denseSize++;
+        defragCleanRun = 0;
         assert(denseSize <= denseCapacity);
-        assert(entityIdx < entityToDenseCapacity);
 
-        return (uint8_t *)dst;
+        return dst;
     }
 
-    // Returns nullptr if thing doesn't exist
-    uint8_t *find(uint32_t entityIdx) {
-        if (entityIdx >= entityToDenseCapacity) return nullptr;
+    // Appends count uninitialized slots for the given entities and returns the first one.
+    // The caller is expected to fill all of them before anything else touches this storage.
+    T *pushRange(const uint32_t *entityIdx, uint32_t count)
+    {
+        if (count == 0)
+            return dense + denseSize;
+
+        // --- Dense ---
+        if (denseSize + count > denseCapacity) {
+            growDense(denseSize + count);
+        }
+        uint32_t firstDenseIdx = denseSize;
+        std::memcpy(denseToEntity + firstDenseIdx, entityIdx, count * sizeof(uint32_t));
+
+        // --- Entity -> Dense ---
+        for (uint32_t i = 0; i < count; i++)
+        {
+            assert(denseIndexOf(entityIdx[i]) == SENTINEL);
+            mapEntity(entityIdx[i], firstDenseIdx + i);
+        }
+
+        denseSize += count;
+        defragCleanRun = 0;
+        assert(denseSize <= denseCapacity);
 
-        uint32_t denseIdx = entityToDense[entityIdx];
+        return dense + firstDenseIdx;
+    }
+
+    bool defragSettled() const { return defragCleanRun >= denseSize; }
+
+    // Returns nullptr if thing doesn't exist
+    T *find(uint32_t entityIdx) {
+        uint32_t denseIdx = denseIndexOf(entityIdx);
         if (denseIdx == SENTINEL) return nullptr;
 
         assert(denseIdx < denseSize);
-        return denseBytes + size_t(denseIdx * componentSize);
+        return dense + denseIdx;
+    }
+
+    // Unchecked lookup. Caller must already know (e.g. from the entity signature) that the component exists.
+    T &at(uint32_t entityIdx) {
+        assert(denseIndexOf(entityIdx) != SENTINEL);
+        return dense[denseIndexOf(entityIdx)];
     }
 
     void erase(uint32_t entityIdx)
     {
-        assert(entityIdx < entityToDenseCapacity);
         assert(denseSize > 0);
 
-        uint32_t denseIdx = entityToDense[entityIdx];
+        uint32_t denseIdx = denseIndexOf(entityIdx);
         assert(denseIdx != SENTINEL);
         assert(denseIdx < denseSize);
 
         uint32_t lastDenseIdx  = --denseSize;
         uint32_t lastEntityIdx = denseToEntity[lastDenseIdx];
+        defragCleanRun = 0;
 
         // Mark removed
-        entityToDense[entityIdx] = SENTINEL;
+        unmapEntity(entityIdx);
 
         if (denseIdx != lastDenseIdx) {
             // Move last element into the hole
-            void* dst = denseBytes + size_t(denseIdx) * componentSize;
-            void* src = denseBytes + size_t(lastDenseIdx) * componentSize;
-            std::memcpy(dst, src, componentSize);
+            std::memcpy(dense + denseIdx, dense + lastDenseIdx, sizeof(T));
 
             denseToEntity[denseIdx] = lastEntityIdx;
-            entityToDense[lastEntityIdx] = denseIdx;
+            mapEntity(lastEntityIdx, denseIdx);
+        }
+    }
+
+    /**
+     * Erases several entities at once. entityIdx is used as scratch and gets reordered.
+     *
+     * Holes are filled from the back in descending dense order. Everything behind the hole that is being
+     * filled has already been removed, so only surviving components are ever moved.
+     */
+    void eraseMany(uint32_t *entityIdx, uint32_t count)
+    {
+        // --- Entity -> Dense, in place ---
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t denseIdx = denseIndexOf(entityIdx[i]);
+            assert(denseIdx != SENTINEL);
+            unmapEntity(entityIdx[i]);
+            entityIdx[i] = denseIdx;
+        }
+        uint32_t *denseIdx = entityIdx;
+        std::sort(denseIdx, denseIdx + count, std::greater<uint32_t>());
+        if (count > 0)
+            defragCleanRun = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            assert(i == 0 || denseIdx[i] != denseIdx[i - 1]);
+            uint32_t hole = denseIdx[i];
+            uint32_t lastDenseIdx = --denseSize;
+            if (hole == lastDenseIdx)
+                continue;
+
+            uint32_t lastEntityIdx = denseToEntity[lastDenseIdx];
+            std::memcpy(dense + hole, dense + lastDenseIdx, sizeof(T));
+            denseToEntity[hole] = lastEntityIdx;
+            mapEntity(lastEntityIdx, hole);
+        }
+    }
+
+    void markChanged(uint32_t entityIdx)
+    {
+        static_assert(ComponentTraits<T>::trackChanges, "Enable trackChanges in ComponentTraits for this component");
+        if (entityIdx >= changedFlags.size())
+            changedFlags.resize(SnakeMath::roundUpMultiplePow2(entityIdx + 1, MEM_CHUNK_SIZE), 0);
+
+        if (changedFlags[entityIdx])
+            return;
+
+        changedFlags[entityIdx] = 1;
+        changed.push_back(entityIdx);
+    }
+
+    void clearChanges()
+    {
+        for (uint32_t entityIdx : changed)
+            changedFlags[entityIdx] = 0;
+        changed.clear();
+    }
+
+    /**
+     * Sorts the window starting at defragCursor by key(entityIdx) and moves the cursor one block ahead.
+     *
+     * Windows are two blocks wide and overlap by one block, so a full sweep works like a block bubble sort.
+     * After as many sweeps as there are blocks the whole array is sorted. Returns the number of components
+     * that were looked at. Once defragCleanRun reaches denseSize a whole sweep found nothing to do.
+     */
+    template <typename KeyFn>
+    uint32_t defragStep(KeyFn &&key, DefragScratch &scratch)
+    {
+        if (defragCursor + ECS_DEFRAG_BLOCK >= denseSize)
+            defragCursor = 0;
+
+        uint32_t first = defragCursor;
+        uint32_t count = std::min(denseSize - first, 2 * ECS_DEFRAG_BLOCK);
+        defragCursor += ECS_DEFRAG_BLOCK;
+        if (count < 2)
+        {
+            defragCleanRun = denseSize;
+            return count;
+        }
+
+        // --- Keys ---
+        scratch.keyed.resize(count);
+        bool sorted = true;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            scratch.keyed[i] = {key(denseToEntity[first + i]), i};
+            sorted = sorted && (i == 0 || scratch.keyed[i - 1].first <= scratch.keyed[i].first);
+        }
+        if (sorted)
+        {
+            defragCleanRun += ECS_DEFRAG_BLOCK;
+            return count;
+        }
+        defragCleanRun = 0;
+
+        std::stable_sort(scratch.keyed.begin(), scratch.keyed.end(),
+                         [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        // --- Permute ---
+        scratch.components.resize(size_t(count) * sizeof(T));
+        scratch.entities.resize(count);
+        std::memcpy(scratch.components.data(), dense + first, size_t(count) * sizeof(T));
+        std::memcpy(scratch.entities.data(), denseToEntity + first, count * sizeof(uint32_t));
+
+        const T *oldComponents = (const T *)scratch.components.data();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t from = scratch.keyed[i].second;
+            uint32_t entityIdx = scratch.entities[from];
+            std::memcpy(dense + first + i, oldComponents + from, sizeof(T));
+            denseToEntity[first + i] = entityIdx;
+            mapEntity(entityIdx, first + i);
         }
+
+        return count;
+    }
+
+    // Share of neighbouring components that are in key order. 1.0 means fully sorted.
+    template <typename KeyFn>
+    float sortedness(KeyFn &&key) const
+    {
+        if (denseSize < 2)
+            return 1.0f;
+
+        uint32_t inOrder = 0;
+        uint64_t prev = key(denseToEntity[0]);
+        for (uint32_t i = 1; i < denseSize; i++)
+        {
+            uint64_t cur = key(denseToEntity[i]);
+            inOrder += prev <= cur;
+            prev = cur;
+        }
+        return float(inOrder) / float(denseSize - 1);
     }
 
     // TODO: We could keep dense and denseToEntity in one block 
     // TODO: Allocate so that things align with Cache line 
     // TODO: Memset only the new bytes. 
-    void growDense() {
-        size_t need = size_t(denseSize) + 1;
+    void growDense(uint32_t need) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
         size_t newCapacity = SnakeMath::roundUpMultiplePow2(need, MEM_CHUNK_SIZE);
-        void *newDenseBytes = malloc(newCapacity * componentSize);
-        if (!newDenseBytes)
+
+        if constexpr (ECS_RESERVE_AND_COMMIT)
+        {
+            if (!denseRange.base)
+            {
+                denseRange.reserve(size_t(MAX_ENTITIES) * sizeof(T));
+                denseToEntityRange.reserve(size_t(MAX_ENTITIES) * sizeof(uint32_t));
+                dense = (T *)denseRange.base;
+                denseToEntity = (uint32_t *)denseToEntityRange.base;
+            }
+
+            // Only the new pages get committed, nothing is copied or cleared
+            assert(newCapacity <= MAX_ENTITIES);
+            denseRange.commitTo(newCapacity * sizeof(T));
+            denseToEntityRange.commitTo(newCapacity * sizeof(uint32_t));
+            denseCapacity = newCapacity;
+
+            assert(denseCapacity > denseSize);
+            return;
+        }
+
+        void *newDense = malloc(newCapacity * sizeof(T));
+        if (!newDense)
             throw std::bad_alloc();
         void *newDenseToEntity = malloc(newCapacity * sizeof(uint32_t));
         if (!newDenseToEntity)
             throw std::bad_alloc();
 
         // --- Initialize memory ---
-        std::memset(newDenseBytes, 0xFF, newCapacity * componentSize);
+        std::memset(newDense, 0xFF, newCapacity * sizeof(T));
         std::memset(newDenseToEntity, 0xFF, newCapacity * sizeof(uint32_t));
 
         // --- Copy over data ---
-        if (denseBytes)
-            std::memcpy(newDenseBytes, denseBytes, denseSize * componentSize);
+        if (dense)
+            std::memcpy(newDense, dense, denseSize * sizeof(T));
         if (denseToEntity)
             std::memcpy(newDenseToEntity, denseToEntity, denseSize * sizeof(uint32_t));
 
         // --- Free ---
-        if (denseBytes)
-            free(denseBytes);
+        if (dense)
+            free(dense);
         if (denseToEntity)
             free(denseToEntity);
 
         // --- Map ---
-        denseBytes = (uint8_t *)newDenseBytes;
+        dense = (T *)newDense;
         denseToEntity = (uint32_t *)newDenseToEntity;
         denseCapacity = newCapacity;
 
         assert(denseCapacity > denseSize);
     }
+};
+
+using ComponentStores = std::tuple<
+    ComponentStorage<AABB>,
+    ComponentStorage<Transform>,
+    ComponentStorage<Mesh>,
+    ComponentStorage<Renderable>,
+    ComponentStorage<Material>,
+    ComponentStorage<UvTransform>,
+    ComponentStorage<EntityType>,
+    ComponentStorage<GroundOre>,
+    ComponentStorage<TransformMeta>>;
+
+template <typename Stores>
+struct ArenaColumns;
+
+template <typename... Ts>
+struct ArenaColumns<std::tuple<ComponentStorage<Ts>...>>
+{
+    using type = std::tuple<Ts *...>;
+};
+
+constexpr uint32_t NO_ARENA = UINT32_MAX;
+constexpr uint32_t CHUNK_ARENA_INITIAL_SLOTS = 64; // Unless the chunk says how many it needs, see reserveChunkEntities
+
+/**
+ * ChunkArena
+ *
+ * Owns the components of every entity that lives in one chunk (SpatialStorage::Chunk). Each entity gets a
+ * slot, released slots are reused.
+ * A column is indexed by slot and only allocated once something pushes that component type. Whether a
+ * slot actually has a component is decided by the entity signature, like everywhere else.
+ *
+ * Unloading a chunk frees its columns in one go instead of erasing component by component.
+ */
+struct ChunkArena
+{
+    ArenaColumns<ComponentStores>::type columns{};
+    uint32_t *entities = nullptr;          // slot -> entity index, SENTINEL when free
+    uint32_t capacity = 0;
+    uint32_t slotCount = 0;                // Every used slot is below this
+    std::vector<uint32_t> freeSlots;       // Released slots
+
+    static constexpr uint32_t SENTINEL = UINT32_MAX;
+
+    void init(uint32_t initialSlots)
+    {
+        assert(initialSlots > 0);
+        grow(initialSlots);
+    }
+
+    template <typename T>
+    T *column()
+    {
+        T *&col = std::get<T *>(columns);
+        if (!col)
+        {
+            col = (T *)malloc(size_t(capacity) * sizeof(T));
+            if (!col)
+                throw std::bad_alloc();
+        }
+        return col;
+    }
+
+    // The column if something ever pushed a T, null otherwise. Never allocates.
+    template <typename T>
+    T *findColumn() const
+    {
+        return std::get<T *>(columns);
+    }
+
+    uint32_t placeStatic(uint32_t entityIdx)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            if (slotCount == capacity)
+                grow(capacity * 2);
+            slot = slotCount++;
+        }
+        entities[slot] = entityIdx;
+        return slot;
+    }
+
+    void releaseSlot(uint32_t slot)
+    {
+        assert(slot < slotCount);
+        entities[slot] = SENTINEL;
+        freeSlots.push_back(slot);
+    }
 
-    void growEntityToDense(uint32_t newIdx)
+    void grow(uint32_t newCapacity)
     {
-        size_t newCapacity = SnakeMath::roundUpMultiplePow2(newIdx, MEM_CHUNK_SIZE);
-        void *newData = malloc(newCapacity * sizeof(uint32_t));
-        if (!newData)
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        assert(newCapacity > capacity);
+        void *newEntities = realloc(entities, size_t(newCapacity) * sizeof(uint32_t));
+        if (!newEntities)
             throw std::bad_alloc();
+        entities = (uint32_t *)newEntities;
+        std::memset(entities + capacity, 0xFF, size_t(newCapacity - capacity) * sizeof(uint32_t));
 
-        // Overwrite new memory
-        // Notice: int _Val is OK because SENTINEL is 0xFFFFFFFF. (If SENTINEL ever changes, replace with a loop.)
-        std::memset(newData, SENTINEL, newCapacity * sizeof(uint32_t));
+        std::apply([&](auto *&...col) { (growColumn(col, newCapacity), ...); }, columns);
+        capacity = newCapacity;
+    }
 
-        // copy existing elements
-        if (entityToDense)
-            std::memcpy(newData, entityToDense, entityToDenseCapacity * sizeof(uint32_t));
+    template <typename T>
+    static void growColumn(T *&col, uint32_t newCapacity)
+    {
+        if (!col)
+            return;
+        void *newCol = realloc(col, size_t(newCapacity) * sizeof(T));
+        if (!newCol)
+            throw std::bad_alloc();
+        col = (T *)newCol;
+    }
 
-        if (entityToDense)
-            free(entityToDense);
+    // Heap memory held by the arena
+    size_t bytes() const
+    {
+        size_t total = size_t(capacity) * sizeof(uint32_t) + freeSlots.capacity() * sizeof(uint32_t);
+        std::apply([&](auto *...col) { ((total += col ? size_t(capacity) * sizeof(*col) : 0), ...); }, columns);
+        return total;
+    }
 
-        entityToDense = (uint32_t *)newData;
-        entityToDenseCapacity = newCapacity;
+    void release()
+    {
+        std::apply([](auto *&...col) { ((free(col), col = nullptr), ...); }, columns);
+        free(entities);
+        entities = nullptr;
+        capacity = 0;
+        slotCount = 0;
+        freeSlots.clear();
     }
 };
 
+// Where an entity's components live. Global entities use the ComponentStorages, the rest a ChunkArena.
+struct EntityLocation
+{
+    uint32_t arena = NO_ARENA;
+    uint32_t slot = 0;
+    uint32_t staticIndex = 0; // Position in Chunk::staticEntities
+};
+
+/**
+ * View over every entity that has all of Ts.
+ *
+ * Iteration is driven by the smallest of the involved dense arrays. Every candidate is filtered on its
+ * signature first, so the remaining stores are only touched for entities that are known to match.
+ * Chunk entities are walked arena by arena, with the arena's columns looked up once per arena.
+ * Structural changes (push/erase/destroy) are not allowed while iterating.
+ */
+template <typename... Ts>
+struct View
+{
+    std::tuple<ComponentStorage<Ts> *...> stores;
+    std::span<ChunkArena> arenas;
+    const ComponentMask *signatures;
+    const uint8_t *generations;
+
+    static constexpr ComponentMask mask = componentMask<Ts...>();
+
+    // Fn: void(Entity, Ts&...)
+    template <typename Fn>
+    void each(Fn &&fn)
+    {
+        const uint32_t *driver = nullptr;
+        uint32_t count = UINT32_MAX;
+        std::apply([&](auto *...store) {
+            ((store->denseSize < count ? (count = store->denseSize, driver = store->denseToEntity) : nullptr), ...);
+        }, stores);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t entityIdx = driver[i];
+            if ((signatures[entityIdx] & mask) != mask)
+                continue;
+
+            Entity entity = Entity{(uint32_t(generations[entityIdx]) << 24) | entityIdx};
+            fn(entity, std::get<ComponentStorage<Ts> *>(stores)->at(entityIdx)...);
+        }
+
+        // Chunk entities, one arena at a time in slot order
+        for (const ChunkArena &arena : arenas)
+            eachIn(arena, fn);
+    }
+
+    // Only the entities of one chunk
+    template <typename Fn>
+    void eachInChunk(const Chunk &chunk, Fn &&fn)
+    {
+        if (chunk.arena != NO_ARENA)
+            eachIn(arenas[chunk.arena], fn);
+    }
+
+    template <typename Fn>
+    void eachIn(const ChunkArena &arena, Fn &&fn)
+    {
+        // A slot can only have T once T's column exists, so one missing column rules out the whole arena
+        std::tuple<Ts *...> columns = {arena.findColumn<Ts>()...};
+        bool complete = std::apply([](auto *...column) { return ((column != nullptr) && ...); }, columns);
+        if (!complete)
+            return;
+
+        for (uint32_t slot = 0; slot < arena.slotCount; slot++)
+        {
+            uint32_t entityIdx = arena.entities[slot];
+            if (entityIdx == ChunkArena::SENTINEL || (signatures[entityIdx] & mask) != mask)
+                continue;
+
+            Entity entity = Entity{(uint32_t(generations[entityIdx]) << 24) | entityIdx};
+            fn(entity, std::get<Ts *>(columns)[slot]...);
+        }
+    }
+
+    uint32_t sizeHint() const
+    {
+        uint32_t count = UINT32_MAX;
+        std::apply([&](auto *...store) { ((count = std::min(count, store->denseSize)), ...); }, stores);
+        for (const ChunkArena &arena : arenas)
+            count += arena.slotCount;
+        return count;
+    }
+};
+
+// Everything createEntity needs, used to create many entities in one go.
+struct EntityDesc
+{
+    Transform transform;
+    Mesh mesh;
+    Material material;
+    RenderLayer renderLayer;
+    EntityType entityType;
+    glm::vec4 uvTransform = glm::vec4{};
+    uint16_t z = 0;
+};
+
 struct EntityManager
 {
     // Entity generations
     std::vector<uint8_t> generations;  // generation per slot
     std::vector<uint32_t> freeIndices; // pool of free slots
 
-    // Each component's storage
-    ComponentStorage *components[(size_t)ComponentId::COUNT];
-    
-    // Spatial storage of entities
-    ankerl::unordered_dense::map<int64_t, Chunk> chunks;
-    
-    // All entites that are currently active
-    std::vector<Entity> activeEntities;
+    // Which components each entity slot currently has
+    std::vector<ComponentMask> signatures;
+
+    // Where each entity slot keeps its components
+    std::vector<EntityLocation> locations;
+
+    // Each component's storage, for entities that don't live in a chunk
+    ComponentStores components;
+
+    // Component storage of chunk entities, one arena per chunk. See Chunk::arena.
+    std::vector<ChunkArena> arenas;
+    std::vector<uint32_t> freeArenas;
     
-    EntityManager()
-    {
-        components[(size_t)ComponentId::AABB] = new ComponentStorage(ComponentId::AABB, sizeof(AABB));
-        components[(size_t)ComponentId::EntityType] = new ComponentStorage(ComponentId::EntityType, sizeof(EntityType));
-        components[(size_t)ComponentId::Health] = new ComponentStorage(ComponentId::Health, sizeof(Health));
-        components[(size_t)ComponentId::Material] = new ComponentStorage(ComponentId::Material, sizeof(Material));
-        components[(size_t)ComponentId::Mesh] = new ComponentStorage(ComponentId::Mesh, sizeof(Mesh));
-        components[(size_t)ComponentId::Renderable] = new ComponentStorage(ComponentId::Renderable, sizeof(Renderable));
-        components[(size_t)ComponentId::Transform] = new ComponentStorage(ComponentId::Transform, sizeof(Transform));
-        components[(size_t)ComponentId::UvTransform] = new ComponentStorage(ComponentId::UvTransform, sizeof(glm::vec4));
-        components[(size_t)ComponentId::Ground] = new ComponentStorage(ComponentId::Ground, sizeof(Ground));
-        components[(size_t)ComponentId::GroundCosmetic] = new ComponentStorage(ComponentId::GroundCosmetic, sizeof(GroundCosmetic));
-        components[(size_t)ComponentId::GroundOre] = new ComponentStorage(ComponentId::GroundOre, sizeof(GroundOre));
-    }
-
-    void push(ComponentId componentId, Entity entity, const void* item) {
-        uint8_t *saved = components[(size_t)componentId]->push(item, entityIndex(entity));
+    // Spatial storage of entities. Every resident chunk has a slot in chunkPool, which chunks maps
+    // packChunkCoords to. The ones around the player are also in chunkWindow, which is what per tile
+    // lookups should go through.
+    ankerl::unordered_dense::map<int64_t, uint32_t> chunks;
+    ChunkPool chunkPool;
+    ChunkWindow chunkWindow;
+
+    // Scratch space for batched create/destroy
+    std::vector<uint32_t> batchIndices;
+    std::vector<uint32_t> eraseScratch;
+    std::vector<uint32_t> rangeScratch;
+    std::vector<uint32_t> rangeGlobalScratch;
+    DefragScratch defragScratch;
+
+    template <typename T>
+    ComponentStorage<T> &storage() {
+        return std::get<ComponentStorage<T>>(components);
+    }
+
+    template <typename T>
+    T *push(Entity entity, const T &item) {
+        uint32_t entityIdx = entityIndex(entity);
+        const EntityLocation &location = locations[entityIdx];
+        T *saved;
+        if (location.arena != NO_ARENA)
+        {
+            saved = arenas[location.arena].column<T>() + location.slot;
+            std::memcpy(saved, &item, sizeof(T));
+        }
+        else
+        {
+            saved = storage<T>().push(item, entityIdx);
+        }
         assert(saved != nullptr);
+        signatures[entityIdx] |= componentMask<T>();
+        return saved;
+    }
+
+    /**
+     * Batched push<T>. make(i) returns the component for entityIdx[i].
+     *
+     * Global entities are appended to the store as one contiguous range, chunk entities are written
+     * straight into their arena slot.
+     */
+    template <typename T, typename Fn>
+    void pushRange(const uint32_t *entityIdx, uint32_t count, Fn &&make) {
+        rangeScratch.clear();
+        rangeGlobalScratch.clear();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const EntityLocation &location = locations[entityIdx[i]];
+            if (location.arena != NO_ARENA)
+            {
+                arenas[location.arena].column<T>()[location.slot] = make(i);
+            }
+            else
+            {
+                rangeScratch.push_back(i);
+                rangeGlobalScratch.push_back(entityIdx[i]);
+            }
+            signatures[entityIdx[i]] |= componentMask<T>();
+        }
+
+        if (rangeScratch.empty())
+            return;
+
+        T *dst = storage<T>().pushRange(rangeGlobalScratch.data(), (uint32_t)rangeGlobalScratch.size());
+        for (size_t i = 0; i < rangeScratch.size(); i++)
+            dst[i] = make(rangeScratch[i]);
+    }
+
+    // Returns nullptr if the entity doesn't have T
+    template <typename T>
+    T *find(Entity entity) {
+        uint32_t entityIdx = entityIndex(entity);
+        const EntityLocation &location = locations[entityIdx];
+        if (location.arena == NO_ARENA)
+            return storage<T>().find(entityIdx);
+
+        if (!(signatures[entityIdx] & componentMask<T>()))
+            return nullptr;
+        return arenas[location.arena].column<T>() + location.slot;
     }
 
-    uint8_t *find(ComponentId componentId, Entity entity) {
-        return components[(size_t)componentId]->find(entityIndex(entity));
+    // Unchecked lookup by entity index. The entity must have T.
+    template <typename T>
+    T &at(uint32_t entityIdx) {
+        assert(signatures[entityIdx] & componentMask<T>());
+        const EntityLocation &location = locations[entityIdx];
+        if (location.arena == NO_ARENA)
+            return storage<T>().at(entityIdx);
+        return arenas[location.arena].column<T>()[location.slot];
+    }
+
+    template <typename T>
+    void erase(Entity entity) {
+        uint32_t entityIdx = entityIndex(entity);
+        if (locations[entityIdx].arena == NO_ARENA)
+            storage<T>().erase(entityIdx);
+        signatures[entityIdx] &= ~componentMask<T>();
+    }
+
+    // Batched erase<T>. entityIdx is used as scratch and gets reordered.
+    template <typename T>
+    void eraseMany(uint32_t *entityIdx, uint32_t count) {
+        // Arena slots are freed by clearing the signature bit, only global entities touch the store
+        uint32_t globalCount = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            signatures[entityIdx[i]] &= ~componentMask<T>();
+            if (locations[entityIdx[i]].arena == NO_ARENA)
+                entityIdx[globalCount++] = entityIdx[i];
+        }
+        storage<T>().eraseMany(entityIdx, globalCount);
+    }
+
+    // Flags T of this entity as modified, so the next sync picks it up
+    template <typename T>
+    void markChanged(Entity entity) {
+        storage<T>().markChanged(entityIndex(entity));
+    }
+
+    // find<T> for writing. Marks the component as changed.
+    template <typename T>
+    T *modify(Entity entity) {
+        T *component = find<T>(entity);
+        if (component)
+            markChanged<T>(entity);
+        return component;
+    }
+
+    /**
+     * Calls fn(entityIdx, T&) once for every entity whose T changed since the last call, then
+     * resets the change list. Entities that lost T in the meantime are skipped.
+     */
+    template <typename T, typename Fn>
+    void consumeChanges(Fn &&fn) {
+        ComponentStorage<T> &store = storage<T>();
+        constexpr ComponentMask bit = componentMask<T>();
+        for (uint32_t entityIdx : store.changed)
+        {
+            if (signatures[entityIdx] & bit)
+                fn(entityIdx, at<T>(entityIdx));
+        }
+        store.clearChanges();
+    }
+
+    template <typename... Ts>
+    bool has(Entity entity) const {
+        constexpr ComponentMask mask = componentMask<Ts...>();
+        return (signatures[entityIndex(entity)] & mask) == mask;
+    }
+
+    // Fetches several components of one entity at once. The entity must have every T.
+    template <typename... Ts>
+    std::tuple<Ts &...> get(Entity entity) {
+        assert(has<Ts...>(entity));
+        uint32_t entityIdx = entityIndex(entity);
+        return std::tuple<Ts &...>(at<Ts>(entityIdx)...);
+    }
+
+    template <typename... Ts>
+    View<Ts...> view() {
+        return View<Ts...>{ {&storage<Ts>()...}, arenas, signatures.data(), generations.data() };
+    }
+
+    // Sort key used to keep dense arrays in chunk/tile order. Entities without a Transform go last.
+    // Chunk arenas are laid out by tile already, so this only reorders the global stores.
+    uint64_t defragKey(uint32_t entityIdx)
+    {
+        Transform *transform = storage<Transform>().find(entityIdx);
+        return transform ? spatialSortKey(transform->position) : UINT64_MAX;
+    }
+
+    /**
+     * Incremental defragmentation. Reorders dense arrays by chunk and tile index, one window at a time,
+     * round robin over all component stores until budgetMicros is used up or every store is settled.
+     */
+    void defragment(uint32_t budgetMicros)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        auto key = [this](uint32_t entityIdx) { return defragKey(entityIdx); };
+        auto start = std::chrono::steady_clock::now();
+        auto budget = std::chrono::microseconds(budgetMicros);
+
+        bool anyWork = true;
+        while (anyWork && std::chrono::steady_clock::now() - start < budget)
+        {
+            anyWork = false;
+            std::apply([&](auto &...store) {
+                ((store.defragSettled() ? void() : (store.defragStep(key, defragScratch), anyWork = true, void())), ...);
+            }, components);
+        }
     }
 
-    void erase(ComponentId componentId, Entity entity) {
-        components[(size_t)componentId]->erase(entityIndex(entity));
+    // Writes the sortedness of every component column, indexed by ComponentId
+    void columnSortedness(float out[(size_t)ComponentId::COUNT])
+    {
+        auto key = [this](uint32_t entityIdx) { return defragKey(entityIdx); };
+        std::apply([&](auto &...store) {
+            ((out[(size_t)std::remove_reference_t<decltype(store)>::componentId] = store.sortedness(key)), ...);
+        }, components);
     }
 
     Entity createEntity(
@@ -248,6 +1016,90 @@ struct EntityManager
         uint16_t z = 0)
     {
         // ---- Generate entity ----
+        Entity entity = allocateEntity();
+
+        // --- Add to spatial storage ---
+        if (spatialStorage == SpatialStorage::Chunk)
+            insertEntityInChunk(entity, transform);
+
+        // ---- Add to stores ----
+        Renderable renderable = {entity, z, 0, renderLayer};
+        renderable.packDrawKey(material.shaderType, mesh.vertexOffset);
+        AABB aabb = computeWorldAABB(mesh, transform);
+
+        push(entity, transform);
+        push(entity, mesh);
+        push(entity, renderable);
+        push(entity, material);
+        push(entity, UvTransform{uvTransform});
+        push(entity, entityType);
+        push(entity, aabb);
+
+        return entity;
+    }
+
+    /**
+     * Creates one entity per desc and writes the result to outEntities.
+     *
+     * Each component column is grown once and filled in one contiguous pass. For Chunk storage every
+     * desc has to be inside the same chunk, since the chunk is only resolved once.
+     */
+    void createEntities(std::span<const EntityDesc> descs, const SpatialStorage &spatialStorage, Entity *outEntities)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        // ---- Generate entities ----
+        for (size_t i = 0; i < descs.size(); i++)
+            outEntities[i] = allocateEntity();
+
+        buildEntities(descs, spatialStorage, outEntities);
+    }
+
+    // Second half of createEntities, for entity ids that were already handed out by allocateEntity
+    // (see EntityCommandBuffer::create).
+    void buildEntities(std::span<const EntityDesc> descs, const SpatialStorage &spatialStorage, const Entity *entities)
+    {
+        uint32_t count = (uint32_t)descs.size();
+        if (count == 0)
+            return;
+
+        batchIndices.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            batchIndices[i] = entityIndex(entities[i]);
+
+        // --- Add to spatial storage ---
+        if (spatialStorage == SpatialStorage::Chunk)
+        {
+            Chunk &chunk = chunkAt(descs[0].transform.position);
+            ChunkArena &arena = arenaOf(chunk);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                assert(&chunkAt(descs[i].transform.position) == &chunk);
+                locations[batchIndices[i]] = {chunk.arena, arena.placeStatic(batchIndices[i]), (uint32_t)chunk.staticEntities.size()};
+                chunk.staticEntities.push_back(entities[i]);
+            }
+        }
+
+        // ---- Add to stores, one column at a time ----
+        const uint32_t *indices = batchIndices.data();
+        pushRange<Transform>(indices, count, [&](uint32_t i) { return descs[i].transform; });
+        pushRange<Mesh>(indices, count, [&](uint32_t i) { return descs[i].mesh; });
+        pushRange<Renderable>(indices, count, [&](uint32_t i) {
+            const EntityDesc &desc = descs[i];
+            Renderable renderable = {entities[i], desc.z, 0, desc.renderLayer};
+            renderable.packDrawKey(desc.material.shaderType, desc.mesh.vertexOffset);
+            return renderable;
+        });
+        pushRange<Material>(indices, count, [&](uint32_t i) { return descs[i].material; });
+        pushRange<UvTransform>(indices, count, [&](uint32_t i) { return UvTransform{descs[i].uvTransform}; });
+        pushRange<EntityType>(indices, count, [&](uint32_t i) { return descs[i].entityType; });
+        pushRange<AABB>(indices, count, [&](uint32_t i) { return computeWorldAABB(descs[i].mesh, descs[i].transform); });
+    }
+
+    Entity allocateEntity()
+    {
         uint32_t index;
         if (!freeIndices.empty())
         {
@@ -260,39 +1112,58 @@ struct EntityManager
             // Allocate new slot
             index = (uint32_t)generations.size();
             generations.push_back(0);
+            signatures.push_back(0);
+            locations.push_back({});
         }
+        assert(signatures[index] == 0);
+
         uint8_t gen = generations[index];
-        Entity entity = Entity{(gen << 24) | index};
+        return Entity{(uint32_t(gen) << 24) | index};
+    }
 
-        // --- Add to spatial storage ---
-        switch (spatialStorage)
-        {
-        case SpatialStorage::Chunk:
+    /**
+     * Batched destroyEntity. Dead or duplicate handles are skipped.
+     *
+     * Every store is visited once, and its removals go through eraseMany so no component that is
+     * about to be removed gets moved by a swap-erase first.
+     */
+    void destroyEntities(std::span<const Entity> entities, const SpatialStorage &spatialStorage)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        // --- Retire handles ---
+        batchIndices.clear();
+        for (Entity e : entities)
         {
-            insertEntityInChunk(entity, transform);
-            break;
+            uint32_t entityIdx = entityIndex(e);
+            if (entityIdx >= generations.size() || !isAlive(e))
+                continue;
+
+            uint8_t &g = generations[entityIdx];
+            g = uint8_t(g + 1);
+            if (g == 0) g = 1;
+
+            freeIndices.push_back(entityIdx);
+            batchIndices.push_back(entityIdx);
         }
-        case SpatialStorage::ChunkTile:
+
+        // --- Remove from spatial storage ---
+        if (spatialStorage == SpatialStorage::Chunk)
         {
-            insertEntityInChunkTile(entity, transform);
-            break;
-        }
+            for (uint32_t entityIdx : batchIndices)
+                deleteEntityFromChunk(entityIdx, at<AABB>(entityIdx));
         }
 
-        // ---- Add to stores ----
-        Renderable renderable = {entity, z, 0, renderLayer};
-        renderable.packDrawKey(material.shaderType, mesh.vertexOffset);
-        AABB aabb = computeWorldAABB(mesh, transform);
-
-        push(ComponentId::Transform, entity, &transform);
-        push(ComponentId::Mesh, entity, &mesh);
-        push(ComponentId::Renderable, entity, &renderable);
-        push(ComponentId::Material, entity, &material);
-        push(ComponentId::UvTransform, entity, &uvTransform);
-        push(ComponentId::EntityType, entity, &entityType);
-        push(ComponentId::AABB, entity, &aabb);
+        // --- Remove from stores ---
+        std::apply([&](auto &...store) { (eraseDestroyed(store), ...); }, components);
 
-        return entity;
+        for (uint32_t entityIdx : batchIndices)
+        {
+            releaseFromArena(entityIdx);
+            signatures[entityIdx] = 0;
+        }
     }
 
     void destroyEntity(Entity e, const SpatialStorage &spatialStorage)
@@ -318,20 +1189,10 @@ struct EntityManager
         }
 
         // --- Remove from spatial storage ---
-        switch (spatialStorage)
-        {
-        case SpatialStorage::Chunk:
+        if (spatialStorage == SpatialStorage::Chunk)
         {
-            AABB *aabb = (AABB*)find(ComponentId::AABB, e);
+            AABB *aabb = find<AABB>(e);
             deleteEntityFromChunk(entityIdx, *aabb);
-            break;
-        }
-        case SpatialStorage::ChunkTile:
-        {
-            AABB *aabb = (AABB*)find(ComponentId::AABB, e);
-            deleteEntityFromChunkTile(*aabb);
-            break;
-        }
         }
 
         // --- Remove from stores ---
@@ -340,19 +1201,16 @@ struct EntityManager
             ZoneScopedN("Remove from stores");
             #endif
 
-            erase(ComponentId::Transform, e);
-            erase(ComponentId::Mesh, e);
-            erase(ComponentId::Material, e);
-            erase(ComponentId::UvTransform, e);
-            erase(ComponentId::EntityType, e);
-            erase(ComponentId::AABB, e);
-            if (find(ComponentId::Health, e)) erase(ComponentId::Health, e);
-            if (find(ComponentId::GroundCosmetic, e)) erase(ComponentId::GroundCosmetic, e);
-            if (find(ComponentId::GroundOre, e)) erase(ComponentId::GroundOre, e);
+            ComponentMask signature = locations[entityIdx].arena == NO_ARENA ? signatures[entityIdx] : 0;
+            std::apply([&](auto &...store) {
+                ((signature & componentMask<typename std::remove_reference_t<decltype(store)>::Component>() ? store.erase(entityIdx) : void()), ...);
+            }, components);
+            releaseFromArena(entityIdx);
+            signatures[entityIdx] = 0;
         }
     }
 
-    bool isAlive(Entity &e) const
+    bool isAlive(const Entity &e) const
     {
         uint32_t index = entityIndex(e);
         uint8_t gen = entityGen(e);
@@ -365,47 +1223,16 @@ struct EntityManager
         ZoneScoped;
         #endif
 
-        int32_t chunkWorldX = worldPosToClosestChunk(aabb.min.x);
-        int32_t chunkWorldY = worldPosToClosestChunk(aabb.min.y);
-        int64_t chunkIdx = packChunkCoords(chunkWorldX, chunkWorldY);
-        auto it = chunks.find(chunkIdx);
-        assert(it != chunks.end());
-        Chunk &chunk = it->second;
+        Chunk &chunk = chunkAt(aabb.min);
 
-        size_t foundAt = chunk.staticEntities.size();
-        for (size_t i = 0; i < chunk.staticEntities.size(); i++)
-        {
-            if (entityIndex(chunk.staticEntities[i]) == entityIdx)
-            {
-                foundAt = i;
-                break;
-            }
-        }
-        assert(foundAt != chunk.staticEntities.size() && "Entity not found in chunk.staticEntities");
-        chunk.staticEntities[foundAt] = chunk.staticEntities.back();
+        uint32_t staticIndex = locations[entityIdx].staticIndex;
+        assert(staticIndex < chunk.staticEntities.size() && entityIndex(chunk.staticEntities[staticIndex]) == entityIdx && "Entity not found in chunk.staticEntities");
+        Entity last = chunk.staticEntities.back();
+        chunk.staticEntities[staticIndex] = last;
+        locations[entityIndex(last)].staticIndex = staticIndex;
         chunk.staticEntities.pop_back();
     }
 
-    void deleteEntityFromChunkTile(const AABB &aabb)
-    {
-        #ifdef _DEBUG
-        ZoneScoped;
-        #endif
-
-        int32_t chunkWorldX = worldPosToClosestChunk(aabb.min.x);
-        int32_t chunkWorldY = worldPosToClosestChunk(aabb.min.y);
-        int64_t chunkIdx = packChunkCoords(chunkWorldX, chunkWorldY);
-        auto it = chunks.find(chunkIdx);
-        assert(it != chunks.end());
-        Chunk &chunk = it->second;
-
-        int32_t localTileX = ((int32_t)aabb.min.x - chunkWorldX) / TILE_WORLD_SIZE;
-        int32_t localTileY = ((int32_t)aabb.min.y - chunkWorldY) / TILE_WORLD_SIZE;
-        size_t tileIdx = localIndexToTileIndex(localTileX, localTileY);
-        Entity &entity = chunk.tiles[tileIdx];
-        entity.id = UINT32_MAX;
-    }
-
     // TODO: Reimplement
     // void collectChunkDebugInstances(std::vector<InstanceData> &instances)
     // {
@@ -430,41 +1257,177 @@ struct EntityManager
     //     }
     // }
 
-    inline void insertEntityInChunk(Entity entity, Transform &transform)
+    // Erases every entity in batchIndices that has a component in this store
+    template <typename T>
+    void eraseDestroyed(ComponentStorage<T> &store)
+    {
+        constexpr ComponentMask bit = componentMask<T>();
+        eraseScratch.clear();
+        for (uint32_t entityIdx : batchIndices)
+            if ((signatures[entityIdx] & bit) && locations[entityIdx].arena == NO_ARENA)
+                eraseScratch.push_back(entityIdx);
+
+        store.eraseMany(eraseScratch.data(), (uint32_t)eraseScratch.size());
+    }
+
+    // Hashes only for chunks outside the window, which are the ones being loaded
+    Chunk &chunkAt(glm::vec2 worldPos)
+    {
+        int32_t chunkX = worldToChunkCoord(worldPos.x);
+        int32_t chunkY = worldToChunkCoord(worldPos.y);
+        if (Chunk *chunk = chunkWindow.find(chunkX, chunkY))
+            return *chunk;
+
+        Chunk *chunk = findChunk(packChunkCoords(chunkX * CHUNK_WORLD_SIZE, chunkY * CHUNK_WORLD_SIZE));
+        assert(chunk);
+        return *chunk;
+    }
+
+    // --- Chunks ---
+
+    bool hasChunk(int64_t chunkIdx) const
+    {
+        return chunks.contains(chunkIdx);
+    }
+
+    // Null if the chunk is not loaded
+    Chunk *findChunk(int64_t chunkIdx)
     {
-        int32_t tileWorldX = transform.position.x;
-        int32_t tileWorldY = transform.position.y;
-        int32_t chunkWorldX = worldPosToClosestChunk(tileWorldX);
-        int32_t chunkWorldY = worldPosToClosestChunk(tileWorldY);
-        int64_t chunkIdx = packChunkCoords(chunkWorldX, chunkWorldY);
         auto it = chunks.find(chunkIdx);
-        assert(it != chunks.end());
-        Chunk &chunk = it->second;
+        return it == chunks.end() ? nullptr : &chunkPool[it->second];
+    }
 
-        chunk.staticEntities.push_back(entity);
+    Chunk &getChunk(int64_t chunkIdx)
+    {
+        return chunkPool[chunks.at(chunkIdx)];
     }
 
-    inline void insertEntityInChunkTile(Entity entity, Transform &transform)
+    // An empty chunk. It keeps its address until it's unloaded.
+    Chunk &createChunk(int32_t chunkWorldX, int32_t chunkWorldY)
     {
-        int32_t tileWorldX = transform.position.x;
-        int32_t tileWorldY = transform.position.y;
-        int32_t chunkWorldX = worldPosToClosestChunk(tileWorldX);
-        int32_t chunkWorldY = worldPosToClosestChunk(tileWorldY);
         int64_t chunkIdx = packChunkCoords(chunkWorldX, chunkWorldY);
+        assert(!hasChunk(chunkIdx));
+        uint32_t slot = chunkPool.acquire(chunkWorldX, chunkWorldY);
+        chunks.emplace(chunkIdx, slot);
+        return chunkPool[slot];
+    }
+
+    // Points the window at the chunks around the given centre chunk, which must all be loaded
+    void recenterChunkWindow(int32_t centerChunkX, int32_t centerChunkY)
+    {
+        chunkWindow.recenter(centerChunkX, centerChunkY, [&](int32_t chunkX, int32_t chunkY) {
+            return &getChunk(packChunkCoords(chunkX * CHUNK_WORLD_SIZE, chunkY * CHUNK_WORLD_SIZE));
+        });
+    }
+
+    inline void insertEntityInChunk(Entity entity, Transform &transform)
+    {
+        Chunk &chunk = chunkAt(transform.position);
+
+        uint32_t entityIdx = entityIndex(entity);
+        ChunkArena &arena = arenaOf(chunk);
+        locations[entityIdx] = {chunk.arena, arena.placeStatic(entityIdx), (uint32_t)chunk.staticEntities.size()};
+        chunk.staticEntities.push_back(entity);
+    }
+
+    // --- Chunk arenas ---
+
+    // The chunk's arena, created on first use
+    ChunkArena &arenaOf(Chunk &chunk, uint32_t initialSlots = CHUNK_ARENA_INITIAL_SLOTS)
+    {
+        if (chunk.arena == NO_ARENA)
+        {
+            if (!freeArenas.empty())
+            {
+                chunk.arena = freeArenas.back();
+                freeArenas.pop_back();
+            }
+            else
+            {
+                chunk.arena = (uint32_t)arenas.size();
+                arenas.emplace_back();
+            }
+            arenas[chunk.arena].init(initialSlots);
+        }
+        return arenas[chunk.arena];
+    }
+
+    // Sizes a freshly loaded chunk's entity storage for count entities, instead of the default
+    void reserveChunkEntities(Chunk &chunk, uint32_t count)
+    {
+        if (count == 0)
+            return;
+
+        chunk.staticEntities.reserve(count);
+        ChunkArena &arena = arenaOf(chunk, count);
+        if (arena.capacity < count)
+            arena.grow(count);
+    }
+
+    void releaseFromArena(uint32_t entityIdx)
+    {
+        EntityLocation &location = locations[entityIdx];
+        if (location.arena == NO_ARENA)
+            return;
+
+        arenas[location.arena].releaseSlot(location.slot);
+        location = {};
+    }
+
+    // Rough memory footprint of a chunk and the entities stored in it
+    size_t chunkBytes(const Chunk &chunk) const
+    {
+        size_t bytes = sizeof(Chunk)
+            + chunk.overlays.capacity() * sizeof(Entity)
+            + chunk.staticEntities.capacity() * sizeof(Entity);
+        if (chunk.arena != NO_ARENA)
+            bytes += arenas[chunk.arena].bytes();
+        return bytes;
+    }
+
+    /**
+     * Destroys every entity of the chunk and drops the chunk.
+     *
+     * Handles are retired one by one, but components are never erased individually: the chunk's arena
+     * is released as a whole. Instance data and the active set are the caller's business, so deactivate
+     * the chunk first.
+     */
+    void unloadChunk(int64_t chunkIdx)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
         auto it = chunks.find(chunkIdx);
-        assert(it != chunks.end());
-        Chunk &chunk = it->second;
+        if (it == chunks.end())
+            return;
+        Chunk &chunk = chunkPool[it->second];
+        assert(!chunkWindow.find(chunk.chunkX / CHUNK_WORLD_SIZE, chunk.chunkY / CHUNK_WORLD_SIZE) && "Chunk is still in the window");
 
-        int32_t localTileX_world = tileWorldX - chunkWorldX;
-        int32_t localTileY_world = tileWorldY - chunkWorldY;
-        int32_t localTileX = localTileX_world / TILE_WORLD_SIZE;
-        int32_t localTileY = localTileY_world / TILE_WORLD_SIZE;
+        uint32_t arenaIdx = chunk.arena;
+        if (arenaIdx != NO_ARENA)
+        {
+            ChunkArena &arena = arenas[arenaIdx];
+            for (uint32_t slot = 0; slot < arena.slotCount; slot++)
+            {
+                uint32_t entityIdx = arena.entities[slot];
+                if (entityIdx == ChunkArena::SENTINEL)
+                    continue;
+
+                uint8_t &g = generations[entityIdx];
+                g = uint8_t(g + 1);
+                if (g == 0) g = 1;
 
-        assert(localTileX >= 0 && localTileX < TILES_PER_ROW);
-        assert(localTileY >= 0 && localTileY < TILES_PER_ROW);
-        int32_t tileIdx = localIndexToTileIndex(localTileX, localTileY);
-        assert(tileIdx >= 0 && tileIdx < TILES_PER_CHUNK);
+                freeIndices.push_back(entityIdx);
+                signatures[entityIdx] = 0;
+                locations[entityIdx] = {};
+            }
+
+            arena.release();
+            freeArenas.push_back(arenaIdx);
+        }
 
-        chunk.tiles[tileIdx] = entity;
+        chunkPool.release(it->second);
+        chunks.erase(it);
     }
 };
@@ -1,16 +1,22 @@
 #pragma once
-#include "components/Health.h"
 #include "components/EntityType.h"
 #include "components/Material.h"
 #include "components/Transform.h"
-#include "components/Ground.h"
 #include "GpuExecutor.h"
 #include "CaveSystem.h"
+#include "ChunkStreamer.h"
+#include "ChunkResidency.h"
+#include "RegionStore.h"
+#include "ChunkActivationQueue.h"
 #include "Vertex.h"
 #include "MeshRegistry.h"
 #include "EntityManager.h"
+#include "EntityCommandBuffer.h"
 #include "Camera.h"
 #include "Collision.h"
+#include "AABBTree.h"
+#include "WorldQuery.h"
+#include "TileSweep.h"
 #include "TextureComponent.h"
 #include "Colors.h"
 #include "SnakeMath.h"
@@ -35,6 +41,9 @@
 #include <cstdlib>
 #include <iostream>
 #include <set>
+#include <limits>
+#include <algorithm>
+#include <iterator>
 
 // PROFILING
 #ifdef _DEBUG
@@ -47,63 +56,6 @@
 const int playerLength = 4;
 const size_t CHUNK_CACHE_CAPACITY = 32;
 
-struct U32Set
-{
-    size_t capacity = 0;
-    bool *_data = nullptr;
-
-    bool slotEmpty(uint32_t idx)
-    {
-        return _data[idx] == false;
-    }
-
-    void set(uint32_t idx)
-    {
-        if (idx >= capacity)
-            grow(idx);
-
-        _data[idx] = true;
-    }
-
-    bool get(uint32_t idx)
-    {
-        if (idx >= capacity)
-            return false;
-
-        return _data[idx];
-    }
-
-    void erase(uint32_t idx)
-    {
-        assert(idx < capacity);
-        assert(!slotEmpty(idx));
-
-        _data[idx] = false;
-    }
-
-    void grow(uint32_t newIdx)
-    {
-        const uint32_t MEM_CHUNK_SIZE = 0xFFFF;
-        size_t newCapacity = SnakeMath::roundUpMultiplePow2(newIdx, MEM_CHUNK_SIZE);
-        void *newData = malloc(newCapacity * sizeof(bool));
-        if (!newData)
-            throw std::bad_alloc();
-
-        // Overwrite new memory
-        std::memset(newData, false, newCapacity * sizeof(bool));
-
-        // copy existing elements
-        if (_data)
-            std::memcpy(newData, _data, capacity * sizeof(bool));
-
-        if (_data)
-            free(_data);
-
-        _data = (bool *)newData;
-        capacity = newCapacity;
-    }
-};
-
 enum class SnakeSegmentType : uint16_t {
     Drill,
     Storage,
@@ -115,6 +67,7 @@ enum class SnakeSegmentType : uint16_t {
 struct SnakeSegment {
     SnakeSegmentType type;
     Entity entity;
+    uint32_t proxy; // In Game::dynamicBodies
 };
 
 struct Player
@@ -145,6 +98,16 @@ const float friction = 4.0f;
 const uint32_t snakeSize = 32;
 const double PARTICLE_SPAWN_INTERVAL = 0.2f;
 const double JOB_INTERVAL = 1.0f;
+const uint32_t DEFRAG_BUDGET_MICROS = 250;
+const uint32_t CHUNK_ACTIVATION_BUDGET_MICROS = 500;
+const int32_t CHUNK_MUST_ACTIVATE_RADIUS = 1;  // Chunks this close to the player are drawn right away, they can be drilled
+const double SIM_STEP = 1.0 / 120.0;         // Gameplay always advances in steps of this, see updateSimulation
+const uint32_t MAX_SIM_STEPS_PER_FRAME = 8;  // Below 15 fps the game slows down instead of spiralling
+const double STATS_INTERVAL = 1.0f;
+const double AUTOSAVE_INTERVAL = 60.0f;
+const char *const WORLD_SAVE_DIRECTORY = "saves/world";
+const float CHUNK_PREFETCH_SECONDS = 0.75f;  // How far ahead along playerVelocity chunks get planned
+const int32_t CHUNK_READY_KEEP_DISTANCE = 4; // Planned chunks further away than this (in chunks) are dropped
 
 struct Game {
     // Timing
@@ -157,12 +120,28 @@ struct Game {
     bool gameOver = false;
     Background background;
     Player player;
+    Transform playerPrevStep[playerLength]; // Player segments before the last simulation step
+    Transform playerRender[playerLength];   // Player segments as drawn this frame, between the last two steps
     Camera camera;
+    AABBTree dynamicBodies; // Broadphase of everything that moves, tiles are in Chunk::solidMask
+    WorldQueryBatch worldQueries; // Scratch for one-off tile queries, systems with many keep their own batch
     uint64_t prevChunks[CHUNK_CACHE_CAPACITY];
     size_t prevChunksSize = 0;
     uint64_t curChunks[CHUNK_CACHE_CAPACITY];
     size_t curChunksSize = 0;
-    U32Set entitiesToDeleteCache;
+    EntityCommandBuffer commands;
+
+    // Every drawn chunk owns one range of TILES_PER_CHUNK tile instance keys, see Chunk::renderSlot
+    std::vector<uint32_t> freeTileRenderSlots;
+    uint32_t tileRenderSlotCount = 0;
+
+    // --- Chunk streaming ---
+    ChunkStreamer chunkStreamer;
+    ankerl::unordered_dense::map<int64_t, std::unique_ptr<ChunkBlueprint>> readyChunks;
+    std::vector<std::unique_ptr<ChunkBlueprint>> collectedChunks;
+    ChunkResidency residency;
+    ChunkActivationQueue activationQueue;
+    RegionStore regionStore;
     KeyState keyStates[GLFW_KEY_LAST]; 
 
     // -- Player ---
@@ -186,39 +165,69 @@ struct Game {
     ma_engine audioEngine;
     ma_sound engineIdleAudio;
 
+    // Stats
+    uint32_t activeEntities = 0; // Entities with instance data, the ones that are drawn
+
     // Timers
+    double simAccumulator = 0.0; // Frame time not simulated yet, at most SIM_STEP after updateSimulation
     float globalTime = 0.0f;
     double particleTimer = 0.0f;
     double jobsTimer = 0.0f;
+    double statsTimer = 0.0f;
+    double autosaveTimer = AUTOSAVE_INTERVAL;
 
-    void updateInstanceData(Entity &entity, Transform &transform) {
+    // Copies every Transform, Material and UvTransform that changed this frame into its InstanceData
+    void syncInstanceData() {
         #ifdef _DEBUG
         ZoneScoped;
         #endif
-        Renderable *renderable = (Renderable*)ecs->find(ComponentId::Renderable, entity);
-        Material *material = (Material*)ecs->find(ComponentId::Material, entity);
-        InstanceData *instanceData = gpuExecutor->instanceStorage.find(entity);
-        assert(instanceData);
-
-        instanceData->model = transform.model;
-        instanceData->worldSize = transform.size;
-        instanceData->textureSize = (*material).size;
+
+        RendererInstanceStorage &instances = gpuExecutor->instanceStorage;
+
+        ecs->consumeChanges<Transform>([&](uint32_t entityIdx, Transform &transform) {
+            InstanceData *instanceData = instances.tryFind(entityIdx);
+            if (!instanceData) return;
+            instanceData->model = transform.model.toMat4();
+            instanceData->worldSize = transform.size;
+        });
+
+        ecs->consumeChanges<Material>([&](uint32_t entityIdx, Material &material) {
+            InstanceData *instanceData = instances.tryFind(entityIdx);
+            if (!instanceData) return;
+            instanceData->color = material.color;
+            instanceData->textureSize = material.size;
+        });
+
+        ecs->consumeChanges<UvTransform>([&](uint32_t entityIdx, UvTransform &uvTransform) {
+            InstanceData *instanceData = instances.tryFind(entityIdx);
+            if (!instanceData) return;
+            instanceData->uvTransform = uvTransform.value;
+        });
+
+        // The player is drawn between simulation steps, not where the last step left it
+        for (size_t i = 0; i < player.entities.size(); i++) {
+            InstanceData *instanceData = instances.tryFind(entityIndex(player.entities[i].entity));
+            if (!instanceData) continue;
+            instanceData->model = playerRender[i].model.toMat4();
+        }
     }
 
     void createInstanceData(Entity entity) {
+        auto [transform, material, mesh, uvTransform, renderable] = ecs->get<Transform, Material, Mesh, UvTransform, Renderable>(entity);
+        createInstanceData(entity, transform, material, mesh, uvTransform, renderable);
+    }
+
+    // For callers that already hold the components, like a View over many entities
+    void createInstanceData(Entity entity, const Transform &transform, const Material &material, const Mesh &mesh,
+                            const UvTransform &uvTransform, const Renderable &renderable) {
         #ifdef _DEBUG
         ZoneScoped;
         #endif
-        Transform transform = *(Transform*)ecs->find(ComponentId::Transform, entity);
-        Material material = *(Material*)ecs->find(ComponentId::Material, entity);
-        Mesh mesh = *(Mesh*)ecs->find(ComponentId::Mesh, entity);
-        glm::vec4 uvTransform = *(glm::vec4*)ecs->find(ComponentId::UvTransform, entity);
-        Renderable renderable = *(Renderable*)ecs->find(ComponentId::Renderable, entity);
 
         InstanceData instance = {
-            transform.model,
+            transform.model.toMat4(),
             material.color,
-            uvTransform,
+            uvTransform.value,
             transform.size,
             material.size,
             renderable.renderLayer,
@@ -228,14 +237,16 @@ struct Game {
             mesh,
             material.atlasIndex,
             renderable.drawkey,
-            entity,
+            entityInstanceKey(entity),
         };
 
         gpuExecutor->instanceStorage.push(instance);
+        activeEntities++;
     }
 
     void removeInstanceData(Entity entity) {
         gpuExecutor->instanceStorage.erase(entity);
+        activeEntities--;
     }
 
     void createPlayer() {
@@ -249,7 +260,7 @@ struct Game {
             AtlasRegion region = atlasRegions[itemsDatabase[uiSystem->loadoutDrill].sprite];
             glm::vec4 uvTransform = getUvTransform(region);
             Material material = Material{Colors::fromHex(Colors::WHITE, 1.0f), ShaderType::TextureScrolling, AtlasIndex::Sprite, {32.0f, 32.0f}};
-            Transform transform = Transform{ .position = posCursor, .size = glm::vec2{snakeSize, snakeSize}, .name = "player"};
+            Transform transform = Transform{ .position = posCursor, .size = glm::vec2{snakeSize, snakeSize}};
             transform.commit();
             Mesh mesh = MeshRegistry::triangle;
             Entity entity = ecs->createEntity(transform,
@@ -260,9 +271,9 @@ struct Game {
                                                     spatialStorage,
                                                     uvTransform,
                                                     2.0f);
-            player.entities[0] = { .type = SnakeSegmentType::Drill, .entity = entity };
+            ecs->push(entity, TransformMeta{ .name = "player" });
+            player.entities[0] = { .type = SnakeSegmentType::Drill, .entity = entity, .proxy = dynamicBodies.createProxy(*ecs->find<AABB>(entity), entity) };
             createInstanceData(entity);
-            ecs->activeEntities.push_back(entity);
         }
 
         // --- BODY SEGMENTS ---
@@ -284,14 +295,20 @@ struct Game {
                 AtlasRegion region = regions[i];
                 glm::vec4 uvTransform = getUvTransform(region);
                 posCursor -= glm::vec2{snakeSize, 0.0f};
-                Transform transform = Transform{ .position = posCursor, .size = glm::vec2{snakeSize, snakeSize}, .name = "player"};
+                Transform transform = Transform{ .position = posCursor, .size = glm::vec2{snakeSize, snakeSize}};
                 transform.commit();
                 Entity entity = ecs->createEntity(transform, mesh, material, layer, entityType, spatialStorage, uvTransform, 2.0f);
-                player.entities[i + 1] = { .type = snakeTypes[i], .entity = entity };
+                ecs->push(entity, TransformMeta{ .name = "player" });
+                player.entities[i + 1] = { .type = snakeTypes[i], .entity = entity, .proxy = dynamicBodies.createProxy(*ecs->find<AABB>(entity), entity) };
                 createInstanceData(entity);
-                ecs->activeEntities.push_back(entity);
             }
         }
+
+        // Nothing to interpolate from until the first simulation step
+        for (size_t i = 0; i < player.entities.size(); i++) {
+            playerPrevStep[i] = *ecs->find<Transform>(player.entities[i].entity);
+            playerRender[i] = playerPrevStep[i];
+        }
     }
 
     void init() {
@@ -328,7 +345,6 @@ struct Game {
                 Entity entity = ecs->createEntity(trans, mesh, material, layer, EntityType::Background, SpatialStorage::Global, uvTransform, 0.0f);
                 background = {entity};
                 createInstanceData(entity);
-                ecs->activeEntities.push_back(entity);
             }
 
             createPlayer();
@@ -337,7 +353,12 @@ struct Game {
             camera = Camera{ .screenW = window->width, .screenH = window->height};
 
             // --- Ground ----
-            caveSystem->createGraceArea();
+            caveSystem->setSeed(regionStore.open(WORLD_SAVE_DIRECTORY, caveSystem->seed));
+            for (int dx = -2; dx <= 2; dx++)
+                for (int dy = -2; dy <= 2; dy++)
+                    loadChunk(packChunkCoords(dx * CHUNK_WORLD_SIZE, dy * CHUNK_WORLD_SIZE), dx * CHUNK_WORLD_SIZE, dy * CHUNK_WORLD_SIZE);
+            uint32_t chunkWorkers = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+            chunkStreamer.start(caveSystem, chunkWorkers);
 
             // --- AUDIO ---
             maResult = ma_engine_set_volume(&audioEngine, 0.025);
@@ -388,17 +409,19 @@ struct Game {
             
             double currentTime = glfwGetTime();
             double delta = currentTime - lastTime;
-            delta = std::fmin(delta, 0.033);
+            delta = std::fmin(delta, SIM_STEP * MAX_SIM_STEPS_PER_FRAME);
             lastTime = currentTime;
 
             // TODO Add arena that will be used for every allocations within this frame's lifetime.
             updateTimers(delta);
-            updateGame(delta);
+            updateGame();
+            updateSimulation(delta);
             updatePlayer();
             updateEngineRevs();
             updateCamera();
             updateLifecycle();
             updateUISystem();
+            syncInstanceData();
             updateFPSCounter(delta);
             gpuExecutor->recordCommands(camera, globalTime, delta);
             keysEnd();
@@ -408,6 +431,8 @@ struct Game {
             #endif
         }
 
+        chunkStreamer.stop();
+        saveWorld();
         ma_sound_uninit(&engineIdleAudio);
         ma_engine_uninit(&audioEngine);
     }
@@ -422,11 +447,8 @@ struct Game {
 
             // Update ecs
             AtlasRegion &region = atlasRegions[drill.sprite];
-            glm::vec4 *uvTransform = (glm::vec4*)ecs->find(ComponentId::UvTransform, head);
-            *uvTransform = getUvTransform(region);
-
-            // Update rendering
-            gpuExecutor->instanceStorage.find(head)->uvTransform = *uvTransform;
+            UvTransform *uvTransform = ecs->modify<UvTransform>(head);
+            uvTransform->value = getUvTransform(region);
 
             // Reset change flag
             uiSystem->loadoutChanged = false;
@@ -441,47 +463,178 @@ struct Game {
         }
     }
 
+    // Called once the window has been recentered on the chunk
     void addChunkEntities(uint64_t chunkIdx) {
-        Chunk &chunk = ecs->chunks.at(chunkIdx);
-        for (size_t i = 0; i < CHUNK_WORLD_SIZE; i++)
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(chunkIdx);
+        Chunk *found = ecs->chunkWindow.find(chunkWorldX / CHUNK_WORLD_SIZE, chunkWorldY / CHUNK_WORLD_SIZE);
+        assert(found && "Chunk outside the chunk window");
+        Chunk &chunk = *found;
+        addChunkTiles(chunk);
+
+        ecs->view<Transform, Material, Mesh, UvTransform, Renderable>().eachInChunk(chunk,
+            [&](Entity entity, Transform &transform, Material &material, Mesh &mesh, UvTransform &uvTransform, Renderable &renderable) {
+                createInstanceData(entity, transform, material, mesh, uvTransform, renderable);
+            });
+    }
+
+    void deleteChunkEntities(uint64_t chunkIdx) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        Chunk &chunk = ecs->getChunk(chunkIdx);
+        removeChunkTiles(chunk);
+
+        for (size_t i = 0; i < chunk.staticEntities.size(); i++)
         {
-            Entity &entity = chunk.tiles[i];
+            Entity &entity = chunk.staticEntities[i];
             if (entityUnset(entity))
                 continue;
-            createInstanceData(entity);
-            ecs->activeEntities.push_back(entity);
+
+            removeInstanceData(entity);
         }
+    }
 
-        for (size_t i = 0; i < chunk.staticEntities.size(); i++)
+    void addChunkTiles(Chunk &chunk) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        assert(chunk.renderSlot == UINT32_MAX);
+        if (!freeTileRenderSlots.empty())
         {
-            Entity &entity = chunk.staticEntities[i];
-            createInstanceData(entity);
-            ecs->activeEntities.push_back(entity);
+            chunk.renderSlot = freeTileRenderSlots.back();
+            freeTileRenderSlots.pop_back();
+        }
+        else
+        {
+            chunk.renderSlot = tileRenderSlotCount++;
         }
-    }
 
-    void deleteChunkEntities(uint64_t chunkIdx) {
-        Chunk &chunk = ecs->chunks.at(chunkIdx);
-        for (size_t i = 0; i < CHUNK_WORLD_SIZE; i++)
+        InstanceData instance = caveSystem->groundTileInstance();
+        uint32_t tileSlotBase = chunk.renderSlot * TILES_PER_CHUNK;
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
         {
-            Entity entity = chunk.tiles[i];
-            uint32_t entityIdx = entityIndex(entity);
-            if (entityUnset(entity))
+            if (!chunk.isSolid(tileIdx))
                 continue;
-            removeInstanceData(entity);
-            entitiesToDeleteCache.set(entityIdx);
+
+            Affine2 model = Affine2::fromPlacement(chunk.tileWorldPos(tileIdx), caveSystem->size, 0.0f, DEFAULT_PIVOT);
+            instance.model = model.toMat4();
+            instance.color.a = float(chunk.tileHealth[tileIdx]) / TILE_HEALTH_FULL;
+            instance.instanceKey = tileInstanceKey(tileSlotBase + tileIdx);
+            gpuExecutor->instanceStorage.push(instance);
         }
+    }
 
-        for (size_t i = 0; i < chunk.staticEntities.size(); i++)
+    void removeChunkTiles(Chunk &chunk) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        assert(chunk.renderSlot != UINT32_MAX);
+        uint32_t tileSlotBase = chunk.renderSlot * TILES_PER_CHUNK;
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
         {
-            Entity &entity = chunk.staticEntities[i];
-            uint32_t entityIdx = entityIndex(entity);
-            if (entityUnset(entity))
-                continue;
+            if (chunk.isSolid(tileIdx))
+                gpuExecutor->instanceStorage.erase(tileInstanceKey(tileSlotBase + tileIdx));
+        }
 
-            removeInstanceData(entity);
-            entitiesToDeleteCache.set(entityIdx);
+        freeTileRenderSlots.push_back(chunk.renderSlot);
+        chunk.renderSlot = UINT32_MAX;
+    }
+
+    // Takes over whatever the chunk workers finished and drops planned or queued chunks the player left behind
+    void collectPlannedChunks(int32_t cx, int32_t cy) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        collectedChunks.clear();
+        chunkStreamer.collect(collectedChunks);
+        for (std::unique_ptr<ChunkBlueprint> &blueprint : collectedChunks)
+        {
+            int64_t chunkIdx = packChunkCoords(blueprint->chunkX, blueprint->chunkY);
+            if (ecs->hasChunk(chunkIdx))
+                chunkStreamer.recycle(std::move(blueprint)); // Generated on the main thread in the meantime
+            else
+                readyChunks[chunkIdx] = std::move(blueprint);
         }
+
+        chunkStreamer.prune(cx, cy, CHUNK_READY_KEEP_DISTANCE);
+        std::erase_if(readyChunks, [&](auto &entry) {
+            int32_t distX = std::abs(entry.second->chunkX - cx) / CHUNK_WORLD_SIZE;
+            int32_t distY = std::abs(entry.second->chunkY - cy) / CHUNK_WORLD_SIZE;
+            if (std::max(distX, distY) <= CHUNK_READY_KEEP_DISTANCE)
+                return false;
+            chunkStreamer.recycle(std::move(entry.second));
+            return true;
+        });
+    }
+
+    /**
+     * Asks the chunk workers for everything the player is about to need: first the window around where
+     * playerVelocity will take the head, then the ring just outside the current window.
+     */
+    void prefetchChunks(glm::vec2 headPosition, int32_t cx, int32_t cy) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        auto want = [&](int32_t chunkWorldX, int32_t chunkWorldY) {
+            int64_t chunkIdx = packChunkCoords(chunkWorldX, chunkWorldY);
+            if (ecs->hasChunk(chunkIdx) || readyChunks.contains(chunkIdx))
+                return;
+            chunkStreamer.request(chunkIdx);
+        };
+
+        glm::vec2 ahead = headPosition + playerVelocity * CHUNK_PREFETCH_SECONDS;
+        int32_t aheadX = worldPosToClosestChunk(ahead.x);
+        int32_t aheadY = worldPosToClosestChunk(ahead.y);
+        for (int dx = -2; dx <= 2; dx++)
+            for (int dy = -2; dy <= 2; dy++)
+                want(aheadX + dx * CHUNK_WORLD_SIZE, aheadY + dy * CHUNK_WORLD_SIZE);
+
+        for (int dx = -3; dx <= 3; dx++)
+            for (int dy = -3; dy <= 3; dy++)
+                if (std::abs(dx) == 3 || std::abs(dy) == 3)
+                    want(cx + dx * CHUNK_WORLD_SIZE, cy + dy * CHUNK_WORLD_SIZE);
+    }
+
+    // Commits the chunk from its planned blueprint, or plans it here if the workers didn't get to it in time.
+    // A chunk that was drilled before gets its delta back on the way, from memory or from its region file.
+    void loadChunk(int64_t chunkIdx, int32_t chunkWorldX, int32_t chunkWorldY) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        std::unique_ptr<ChunkBlueprint> planned;
+        auto ready = readyChunks.find(chunkIdx);
+        if (ready != readyChunks.end())
+        {
+            planned = std::move(ready->second);
+            readyChunks.erase(ready);
+        }
+        else
+        {
+            caveSystem->planWorldChunk(chunkWorldX, chunkWorldY, caveSystem->scratchBlueprint);
+        }
+
+        ChunkBlueprint &blueprint = planned ? *planned : caveSystem->scratchBlueprint;
+        bool fromSnapshot = residency.restore(chunkIdx, blueprint);
+        if (!fromSnapshot)
+            regionStore.restore(chunkIdx, blueprint);
+        caveSystem->commitChunk(blueprint);
+        if (planned)
+            chunkStreamer.recycle(std::move(planned));
+
+        // A snapshot is gone once restored, so that chunk's drilling has to be saved again
+        Chunk &chunk = ecs->getChunk(chunkIdx);
+        chunk.unsaved = fromSnapshot;
+        residency.track(chunkIdx, ecs->chunkBytes(chunk));
     }
 
     // --- Game logic ---
@@ -491,14 +644,16 @@ struct Game {
         #endif
 
         // When player moves into a new chunk we should verify that there are in fact 3x3 loaded chunks around the player
-        Transform *head = (Transform*)ecs->find(ComponentId::Transform, player.entities.front().entity);
+        Transform *head = ecs->find<Transform>(player.entities.front().entity);
         int32_t cx = worldPosToClosestChunk(head->position.x);
         int32_t cy = worldPosToClosestChunk(head->position.y);
 
+        collectPlannedChunks(cx, cy);
+
         curChunksSize = 0;
-        for (int dx = -2; dx <= 2; dx++)
+        for (int dx = -CHUNK_WINDOW_RADIUS; dx <= CHUNK_WINDOW_RADIUS; dx++)
         {
-            for (int dy = -2; dy <= 2; dy++)
+            for (int dy = -CHUNK_WINDOW_RADIUS; dy <= CHUNK_WINDOW_RADIUS; dy++)
             {
                 int32_t chunkWorldX = cx + dx * CHUNK_WORLD_SIZE;
                 int32_t chunkWorldY = cy + dy * CHUNK_WORLD_SIZE;
@@ -507,19 +662,21 @@ struct Game {
                 assert(curChunksSize < CHUNK_CACHE_CAPACITY && "You need to increase allocation pal");
                 curChunks[curChunksSize++] = chunkIdx;
 
-                if (ecs->chunks.find(chunkIdx) == ecs->chunks.end())
-                {
-                    caveSystem->generateNewChunk(chunkIdx, chunkWorldX, chunkWorldY);
-                }
+                if (!ecs->hasChunk(chunkIdx))
+                    loadChunk(chunkIdx, chunkWorldX, chunkWorldY);
             }
         }
 
+        ecs->recenterChunkWindow(cx / CHUNK_WORLD_SIZE, cy / CHUNK_WORLD_SIZE);
+
+        prefetchChunks(head->position, cx, cy);
+
         std::sort(curChunks,  curChunks  + curChunksSize);
         std::sort(prevChunks, prevChunks + prevChunksSize);
 
         size_t i = 0, j = 0;
 
-        // walk both sorted lists
+        // walk both sorted lists, chunks that entered or left get queued
         while (i < prevChunksSize && j < curChunksSize)
         {
             uint64_t p = prevChunks[i];
@@ -527,12 +684,12 @@ struct Game {
 
             if (p < c)
             {
-                deleteChunkEntities(p);
+                activationQueue.deactivate(p);
                 ++i;
             }
             else if (c < p)
             {
-                addChunkEntities(c);
+                activationQueue.activate(c);
                 ++j;
             }
             else
@@ -546,123 +703,116 @@ struct Game {
         // leftovers
         while (i < prevChunksSize)
         {
-            deleteChunkEntities(prevChunks[i++]);
+            activationQueue.deactivate(prevChunks[i++]);
         }
         while (j < curChunksSize)
         {
-            addChunkEntities(curChunks[j++]);
+            activationQueue.activate(curChunks[j++]);
         }
 
+        activationQueue.drain(cx / CHUNK_WORLD_SIZE, cy / CHUNK_WORLD_SIZE, CHUNK_MUST_ACTIVATE_RADIUS, CHUNK_ACTIVATION_BUDGET_MICROS,
+            [&](int64_t chunkIdx, bool activate) {
+                if (activate)
+                    addChunkEntities(chunkIdx);
+                else
+                    deleteChunkEntities(chunkIdx);
+            });
+
+        #ifdef _DEBUG
+        TracyPlot("Chunk activation queue", (int64_t)activationQueue.depth());
+        #endif
+
         // now prev becomes cur
         std::memcpy(prevChunks, curChunks, curChunksSize * sizeof(curChunks[0]));
         prevChunksSize = curChunksSize;
-    }
 
-    void handleEntityLifecycle() {
-        // We can read it, but if we don't write it, then it aint' with us
-        size_t writeIndex = 0;
-        size_t readIndex = 0;
-        size_t length = ecs->activeEntities.size();
-        for (; readIndex < length; ++readIndex)
+        for (size_t k = 0; k < curChunksSize; k++)
         {
-            Entity entity = ecs->activeEntities[readIndex];
-            uint32_t entityIdx = entityIndex(entity);
-
-            // --- Check if this got unloaded by chunk rules ---
-            if (entitiesToDeleteCache.get(entityIdx))
-            {
-                entitiesToDeleteCache.erase(entityIdx);
-                continue;
-            }
+            auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(curChunks[k]);
+            const Chunk *chunk = ecs->chunkWindow.find(chunkWorldX / CHUNK_WORLD_SIZE, chunkWorldY / CHUNK_WORLD_SIZE);
+            residency.visit(curChunks[k], ecs->chunkBytes(*chunk));
+        }
+    }
 
-            Renderable *renderable = (Renderable*)ecs->find(ComponentId::Renderable, entity);
+    // Writes every chunk drilled since the last save to its region file. Only those regions are rewritten.
+    void saveWorld() {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
 
-            // --- Handle entity types ---
-            EntityType* entityType = (EntityType*)ecs->find(ComponentId::EntityType, entity);
-            switch (*entityType)
-            {
-            case EntityType::Ground:
-            {
-                Health *health = (Health*)ecs->find(ComponentId::Health, entity);
-                Material *material = (Material*)ecs->find(ComponentId::Material, entity);
-
-                // Check if ground block has died
-                if (health->current > 0)
-                {
-                    float prevAlpha = material->color.a;
-                    material->color.a = health->current / health->max;
-                    if (prevAlpha != material->color.a)
-                    {
-                        InstanceData *instanceData = gpuExecutor->instanceStorage.find(entity);
-                        assert(instanceData);
-                        instanceData->color.a = material->color.a;
-                    }
+        ankerl::unordered_dense::map<int64_t, std::vector<uint8_t>> deltas;
+        residency.collectUnsaved(deltas);
+        if (deltas.empty())
+            return;
 
-                    ecs->activeEntities[writeIndex++] = entity;
-                    break;
-                }
+        try
+        {
+            regionStore.save(deltas);
+        }
+        catch (const std::exception &e)
+        {
+            // Everything stays unsaved and goes out with the next save
+            Logrador::err(std::string("Saving the world failed: ") + e.what());
+            return;
+        }
+        residency.markSaved(deltas);
+    }
 
-                ecs->destroyEntity(entity, SpatialStorage::ChunkTile);
-                gpuExecutor->instanceStorage.erase(entity);
-                break;
-            }
-            case EntityType::OreBlock:
-            {
-                GroundOre *groundOre = (GroundOre*)ecs->find(ComponentId::GroundOre, entity);
+    void updateLifecycle() {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
 
-                // Dies if it has lost it's ground
-                if (ecs->isAlive(groundOre->parentRef))
-                {
-                    ecs->activeEntities[writeIndex++] = entity;
-                    break;
-                }
+        handleChunkLifecycle();
 
-                // Update inventory
-                uiSystem->addItem(groundOre->itemId, 1);
-                
-                ecs->destroyEntity(entity, SpatialStorage::Chunk);
-                gpuExecutor->instanceStorage.erase(entity);
-                break;
-            }
-            case EntityType::GroundCosmetic:
-            {
-                GroundCosmetic *groundCosmetic = (GroundCosmetic*)ecs->find(ComponentId::GroundCosmetic, entity);
+        // Sync point: everything the systems above queued up is applied here
+        commands.flush(*ecs);
 
-                // Dies if it has lost it's ground
-                if (ecs->isAlive(groundCosmetic->parentRef))
-                {
-                    ecs->activeEntities[writeIndex++] = entity;
-                    break;
-                }
+        // Nothing holds on to a chunk past this point, so chunks that were left behind may go
+        residency.evictOverBudget();
 
-                // TODO: Store number of ores somewhere
-                ecs->destroyEntity(entity, SpatialStorage::Chunk);
-                gpuExecutor->instanceStorage.erase(entity);
-                break;
-            }
-            default:
-                ecs->activeEntities[writeIndex++] = entity;
-                break;
-            }
+        if (autosaveTimer <= 0) {
+            saveWorld();
+            autosaveTimer = AUTOSAVE_INTERVAL;
         }
 
-        if (writeIndex < readIndex)
-            ecs->activeEntities.resize(writeIndex);
-    }
+        // Chunk loads and swap-erases scatter the dense arrays, put them back in chunk/tile order
+        ecs->defragment(DEFRAG_BUDGET_MICROS);
 
-    void updateLifecycle() {
         #ifdef _DEBUG
-        ZoneScoped;
-        #endif
+        if (statsTimer <= 0) {
+            float sortedness[(size_t)ComponentId::COUNT];
+            ecs->columnSortedness(sortedness);
+            for (size_t i = 0; i < (size_t)ComponentId::COUNT; i++)
+                TracyPlot(COMPONENT_NAMES[i], sortedness[i]);
+
+            ChunkGenStats &gen = caveSystem->genStats;
+            if (gen.chunks > 0) {
+                TracyPlot("Chunk plan us", gen.planMicros / gen.chunks);
+                TracyPlot("Chunk plan max us", gen.maxPlanMicros);
+                TracyPlot("Chunk commit us", gen.commitMicros / gen.chunks);
+                gen = {};
+            }
 
-        handleChunkLifecycle();
-        handleEntityLifecycle();
+            ChunkResidencyStats res = residency.stats();
+            TracyPlot("Resident chunks", (int64_t)res.residentChunks);
+            TracyPlot("Resident chunk MB", res.residentBytes / (1024.0 * 1024.0));
+            TracyPlot("Chunk snapshots", (int64_t)res.snapshots);
+            TracyPlot("Chunk snapshot KB", res.snapshotBytes / 1024.0);
+            TracyPlot("Chunks evicted", (int64_t)res.evicted);
+            TracyPlot("Chunks restored", (int64_t)res.restored);
+            TracyPlot("Chunks loaded from disk", (int64_t)regionStore.chunksLoaded);
+            TracyPlot("Active entities", (int64_t)activeEntities);
+            TracyPlot("Dynamic bodies", (int64_t)dynamicBodies.proxyCount);
+            TracyPlot("Dynamic body tree height", (int64_t)dynamicBodies.height());
+            statsTimer = STATS_INTERVAL;
+        }
+        #endif
     }
 
     void updateUISystem() {
         // Let UI system know the current position of the player
-        Transform *head = (Transform*)ecs->find(ComponentId::Transform, player.entities.front().entity);
-        uiSystem->playerCenterScreen = WorldToScreenPx(camera, head->getCenter());
+        uiSystem->playerCenterScreen = WorldToScreenPx(camera, playerRender[0].getCenter());
 
         // Update jobs
         if (jobsTimer <= 0) {
@@ -681,12 +831,11 @@ struct Game {
         camera.screenH = gpuExecutor->swapchain.extent.height;
 
         Entity entity = background.entity;
-        Transform *playerTransform = (Transform*)ecs->find(ComponentId::Transform, player.entities.front().entity);
-        Transform *backgroundTransform = (Transform*)ecs->find(ComponentId::Transform, background.entity);
-        Mesh *mesh = (Mesh*)ecs->find(ComponentId::Mesh, entity);
+        Transform *backgroundTransform = ecs->find<Transform>(background.entity);
+        Mesh *mesh = ecs->find<Mesh>(entity);
 
-        // Camera center follows the player
-        camera.position = glm::round(playerTransform->position);
+        // Camera center follows the player as drawn, so it doesn't judder against it
+        camera.position = glm::round(playerRender[0].position);
 
         // Compute visible area size, factoring in zoom
         glm::vec2 viewSize = glm::vec2(camera.screenW, camera.screenH) * (1.0f / camera.zoom);
@@ -695,9 +844,7 @@ struct Game {
         backgroundTransform->position = camera.position - viewSize * 0.5f;
         backgroundTransform->size = viewSize;
         backgroundTransform->commit();
-
-        // Update renderable stuff
-        updateInstanceData(background.entity, *backgroundTransform);
+        ecs->markChanged<Transform>(background.entity);
     }
 
     void updateTimers(double delta) {
@@ -708,22 +855,16 @@ struct Game {
         globalTime += delta;
         particleTimer = std::max(particleTimer - delta, (double)0.0f);
         jobsTimer = std::max(jobsTimer - delta, (double)0.0f);
+        statsTimer = std::max(statsTimer - delta, (double)0.0f);
+        autosaveTimer = std::max(autosaveTimer - delta, (double)0.0f);
     }
 
-    void updateGame(double delta) {
+    // Once per frame: things that react to key presses rather than held keys
+    void updateGame() {
         #ifdef _DEBUG
         ZoneScoped;
         #endif
 
-        // Constants / parameters
-        GLFWwindow *handle = window->handle;
-
-        // --- Rotation ---
-        auto change = rotationSpeed * delta;
-        bool forwardPressed = false;
-        bool leftPressed = false;
-        bool rightPressed = false;
-
         if (keyStates[GLFW_KEY_I].pressed) {
             if (uiSystem->windowState == UIWindowState::INVENTORY) uiSystem->windowState = UIWindowState::COUNT;
             else uiSystem->windowState = UIWindowState::INVENTORY;
@@ -735,14 +876,71 @@ struct Game {
         if (keyStates[GLFW_KEY_ESCAPE].pressed) {
             uiSystem->windowState = UIWindowState::COUNT; // TODO This should probably open some kind of main menu
         }
+    }
+
+    /**
+     * Runs as many fixed SIM_STEP steps as the frame time covers, and carries the rest over to the next
+     * frame. Gameplay (steering, movement, drilling) only ever sees SIM_STEP, so it plays the same at
+     * any frame rate, and a frame costs as many steps as real time passed, whatever the refresh rate.
+     *
+     * What's left in the accumulator places this frame between the last two steps: playerRender is the
+     * player interpolated there, and is what the camera follows and the renderer draws.
+     */
+    void updateSimulation(double delta) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        simAccumulator += delta;
+        uint32_t steps = 0;
+        while (simAccumulator >= SIM_STEP && steps < MAX_SIM_STEPS_PER_FRAME) {
+            for (size_t i = 0; i < player.entities.size(); i++)
+                playerPrevStep[i] = *ecs->find<Transform>(player.entities[i].entity);
+
+            stepSimulation((float)SIM_STEP);
+            simAccumulator -= SIM_STEP;
+            steps++;
+        }
+        simAccumulator = std::fmin(simAccumulator, SIM_STEP);
+
+        float alpha = float(simAccumulator / SIM_STEP);
+        for (size_t i = 0; i < player.entities.size(); i++)
+            playerRender[i] = interpolateTransform(playerPrevStep[i], *ecs->find<Transform>(player.entities[i].entity), alpha);
+
+        #ifdef _DEBUG
+        TracyPlot("Simulation steps", (int64_t)steps);
+        #endif
+    }
 
+    void stepSimulation(float dt) {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        GLFWwindow *handle = window->handle;
         if (glfwGetKey(handle, GLFW_KEY_A) == GLFW_PRESS)
-            rotateHeadLeft(delta);
+            rotateHeadLeft(dt);
         else if (glfwGetKey(handle, GLFW_KEY_D) == GLFW_PRESS)
-            rotateHeadRight(delta);
+            rotateHeadRight(dt);
 
         bool forward = glfwGetKey(handle, GLFW_KEY_W) == GLFW_PRESS;
-        updateMovement(delta, forward);
+        updateMovement(dt, forward);
+        updateDynamicBodies();
+    }
+
+    // Brings the AABBs of everything that moved this step up to date, in the ECS and in dynamicBodies
+    void updateDynamicBodies() {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        for (size_t i = 0; i < player.entities.size(); i++) {
+            const SnakeSegment &segment = player.entities[i];
+            const Transform &transform = *ecs->find<Transform>(segment.entity);
+            AABB &aabb = *ecs->find<AABB>(segment.entity);
+            aabb = computeWorldAABB(*ecs->find<Mesh>(segment.entity), transform);
+            dynamicBodies.moveProxy(segment.proxy, aabb, transform.position - playerPrevStep[i].position);
+        }
     }
 
     void updateEngineRevs() {
@@ -755,7 +953,7 @@ struct Game {
             return;
         }
 
-        Transform *playerTransform = (Transform*)ecs->find(ComponentId::Transform, player.entities.front().entity);
+        Transform *playerTransform = ecs->find<Transform>(player.entities.front().entity);
         glm::vec2 forward = SnakeMath::getRotationVector2(playerTransform->rotation);
         float velocity = glm::dot(playerVelocity, forward);
         float ratio = velocity / playerMaxVelocity;
@@ -764,166 +962,67 @@ struct Game {
         ma_sound_set_pitch(&engineIdleAudio, revs);
     }
 
-    Entity* getTileFromTileCoords(int32_t x, int32_t y) {
-        int32_t tileX_world = x * 32;
-        int32_t tileY_world = y * 32;
-
-        // --- Chunk ---
-        int32_t chunkX_world = worldPosToClosestChunk(tileX_world);
-        int32_t chunkY_world = worldPosToClosestChunk(tileY_world);
-        int64_t chunkIdx = packChunkCoords(chunkX_world, chunkY_world);
-        assert(chunkIdx != UINT64_MAX);
-        assert(ecs->chunks.find(chunkIdx) != ecs->chunks.end());
-        Chunk &chunk = ecs->chunks.at(chunkIdx);
-
-        // --- Chunk space ---
-        int32_t tileX_chunk = tileX_world - chunkX_world;
-        int32_t tileY_chunk = tileY_world - chunkY_world;
-
-        // --- Tile space ---
-        int32_t tileX_tile = tileX_chunk / TILE_WORLD_SIZE;
-        int32_t tileY_tile = tileY_chunk / TILE_WORLD_SIZE;
-        assert(tileX_tile >= 0 && tileX_tile < TILES_PER_ROW);
-        assert(tileY_tile >= 0 && tileY_tile < TILES_PER_ROW);
-        
-        // --- Tile index ---
-        int32_t tileIdx = localIndexToTileIndex(tileX_tile, tileY_tile);
-        assert(tileIdx >= 0 && tileIdx < TILES_PER_CHUNK);
-
-        return &chunk.tiles[tileIdx];
+    TileRef getTileFromTileCoords(int32_t x, int32_t y) {
+        TileRef tile = ecs->chunkWindow.tileAt(x, y);
+        assert(tile.chunk && "Tile outside the chunk window");
+        return tile;
     }
 
-    Entity* circleHitsSolidTiles(glm::vec2 center, float radius) {
-        glm::vec2 minP = center - glm::vec2(radius);
-        glm::vec2 maxP = center + glm::vec2(radius);
-
-        int32_t minTX = worldToTileCoord(minP.x);
-        int32_t maxTX = worldToTileCoord(maxP.x);
-        int32_t minTY = worldToTileCoord(minP.y);
-        int32_t maxTY = worldToTileCoord(maxP.y);
+    // Returns a TileRef without chunk if nothing was hit
+    TileRef circleHitsSolidTiles(glm::vec2 center, float radius) {
+        worldQueries.clear();
+        uint32_t query = worldQueries.circle(center, radius, TileFilter::Solid, 1);
+        worldQueries.run(ecs->chunkWindow);
 
-        for (int32_t ty = minTY; ty <= maxTY; ++ty)
-        {
-            for (int32_t tx = minTX; tx <= maxTX; ++tx)
-            {
-                Entity *entity = getTileFromTileCoords(tx, ty);
-                assert(entity);
-                if (entityUnset(*entity))
-                    continue;
-
-                glm::vec2 bmin = glm::vec2((float)tx, (float)ty) * float(TILE_WORLD_SIZE);
-                glm::vec2 bmax = bmin + glm::vec2(TILE_WORLD_SIZE);
-
-                if (circleIntersectsAABB(center, radius, {bmin, bmax}))
-                {
-                    fprintf(stdout, "COLLIDED AT: (%d, %d)\n", tx, ty);
-                    return entity;
-                }
-            }
-        }
+        std::span<const WorldQueryHit> hits = worldQueries.hitsOf(query);
+        if (hits.empty())
+            return {};
 
-        return nullptr;
+        return hits[0].tile;
     }
 
-    struct TileHit
-    {
-        int32_t tx, ty;
-        float t;
-        Entity *entity;
-    };
-
-    struct TileHitList
-    {
-        Entity *visited[32];
-        TileHit hits[4];
-        uint32_t visitedCount = 0;
-        uint32_t count = 0;
-        float tFirst;
-
-        bool contains(Entity *entity) {
-            for (size_t i = 0; i < visitedCount; i++)
-                if (visited[i] == entity)
-                    return true;
-            return false;
+    // Returns true if the tile broke
+    bool damageTile(Chunk &chunk, uint32_t tileIdx, float damage) {
+        chunk.unsaved = true;
+        uint32_t amount = (uint32_t)std::ceil(damage / caveSystem->groundHealth * TILE_HEALTH_FULL);
+        uint8_t &health = chunk.tileHealth[tileIdx];
+        if (amount >= health)
+        {
+            breakTile(chunk, tileIdx);
+            return true;
         }
-    };
-
-    bool sweepCircleHitsSolidTilesMulti(const glm::vec2& startCenter, const glm::vec2& endCenter, float radius, TileHitList& out) {
-        assert(glm::all(glm::isfinite(startCenter)));
-        assert(glm::all(glm::isfinite(endCenter)));
-        out.tFirst = 1.0f;
-        out.count = 0;
-
-        // compute tile bounds to search (same as before)
-        glm::vec2 minP = glm::min(startCenter, endCenter) - glm::vec2(radius);
-        glm::vec2 maxP = glm::max(startCenter, endCenter) + glm::vec2(radius);
-
-        int32_t minTX = worldToTileCoord(minP.x);
-        int32_t maxTX = worldToTileCoord(maxP.x);
-        int32_t minTY = worldToTileCoord(minP.y);
-        int32_t maxTY = worldToTileCoord(maxP.y);
 
-        // ---- pass 1: find earliest t ----
-        bool found = false;
-        float bestT = 1.0f;
+        health -= amount;
 
-        for (int32_t ty = minTY; ty <= maxTY; ++ty)
-            for (int32_t tx = minTX; tx <= maxTX; ++tx)
-            {
-                Entity *entity = getTileFromTileCoords(tx, ty);
-                if (entityUnset(*entity)) continue;
-
-                glm::vec2 bmin = glm::vec2((float)tx, (float)ty) * float(TILE_WORLD_SIZE);
-                glm::vec2 bmax = bmin + glm::vec2(TILE_WORLD_SIZE);
-
-                glm::vec2 emin = bmin - glm::vec2(radius);
-                glm::vec2 emax = bmax + glm::vec2(radius);
-
-                float tEnter;
-                if (segmentIntersectsAABB(startCenter, endCenter, emin, emax, tEnter))
-                {
-                    if (tEnter >= 0.0f && tEnter < bestT)
-                    {
-                        bestT = tEnter;
-                        found = true;
-                    }
-                }
-            }
-
-        if (!found) return false;
-
-        // ---- pass 2: gather all hits at same time ----
-        const float tEps = 1e-4f; // tune. bigger if your world scale is huge.
-        out.tFirst = bestT;
-
-        for (int32_t ty = minTY; ty <= maxTY; ++ty)
-            for (int32_t tx = minTX; tx <= maxTX; ++tx)
-            {
-                if (out.count == 4) break;
-
-                Entity *entity = getTileFromTileCoords(tx, ty);
-                if (entityUnset(*entity)) continue;
+        // Damaged ground fades out
+        InstanceData *instance = gpuExecutor->instanceStorage.tryFind(tileInstanceKey(chunk.renderSlot * TILES_PER_CHUNK + tileIdx));
+        if (instance)
+            instance->color.a = float(health) / TILE_HEALTH_FULL;
+        return false;
+    }
 
-                glm::vec2 bmin = glm::vec2((float)tx, (float)ty) * float(TILE_WORLD_SIZE);
-                glm::vec2 bmax = bmin + glm::vec2(TILE_WORLD_SIZE);
+    void breakTile(Chunk &chunk, uint32_t tileIdx) {
+        assert(chunk.isSolid(tileIdx));
+        assert(chunk.renderSlot != UINT32_MAX && "Only drawn chunks can be drilled");
+        chunk.setTileType(tileIdx, TileType::Empty);
+        chunk.tileHealth[tileIdx] = 0;
+        gpuExecutor->instanceStorage.erase(tileInstanceKey(chunk.renderSlot * TILES_PER_CHUNK + tileIdx));
 
-                glm::vec2 emin = bmin - glm::vec2(radius);
-                glm::vec2 emax = bmax + glm::vec2(radius);
+        // --- Whatever was on the tile goes with it ---
+        uint16_t overlay = chunk.tileOverlays[tileIdx];
+        if (overlay == NO_TILE_OVERLAY)
+            return;
+        chunk.tileOverlays[tileIdx] = NO_TILE_OVERLAY;
 
-                float tEnter;
-                if (segmentIntersectsAABB(startCenter, endCenter, emin, emax, tEnter))
-                {
-                    if (tEnter >= 0.0f && tEnter <= bestT + tEps && !out.contains(entity)) {
-                        out.hits[out.count++] = { tx, ty, tEnter, entity };
-                        out.visited[out.visitedCount++] = entity;
-                    }
-                }
-            }
+        Entity entity = chunk.overlays[overlay];
+        GroundOre *groundOre = ecs->find<GroundOre>(entity);
+        if (groundOre)
+            uiSystem->addItem(groundOre->itemId, 1); // Update inventory
 
-        return out.count > 0;
+        commands.destroy(entity, SpatialStorage::Chunk);
+        removeInstanceData(entity);
     }
 
-
     void movePlayer(Transform &head, Mesh &mesh, float dt) {
         #ifdef _DEBUG
         ZoneScoped;
@@ -942,31 +1041,31 @@ struct Game {
         int iter = 0;
         TileHitList hitlist;
         for (; iter < 8; ++iter) {
-            if (!sweepCircleHitsSolidTilesMulti(start, end, drillRadius, hitlist))
+            if (!sweepCircleHitsSolidTilesMulti(ecs->chunkWindow, start, end, drillRadius, hitlist))
                 break;
             
             for (size_t i = 0; i < hitlist.count; i++) {
                 TileHit hit = hitlist.hits[i];
                 
+                Chunk &chunk = *hit.tile.chunk;
+
                 // --- Check if we are obstructed by ore ---
-                Ground *ground = (Ground*)ecs->find(ComponentId::Ground, *hit.entity);
-                if (ground->groundOreRef.has_value()) {
-                    GroundOre *groundOre = (GroundOre*)ecs->find(ComponentId::GroundOre, ground->groundOreRef.value());
+                uint16_t overlay = chunk.tileOverlays[hit.tile.tileIdx];
+                if (overlay != NO_TILE_OVERLAY) {
+                    GroundOre *groundOre = ecs->find<GroundOre>(chunk.overlays[overlay]);
 
-                    if ((uint32_t)groundOre->oreLevel > (uint32_t)drillLevel) {
+                    if (groundOre && (uint32_t)groundOre->oreLevel > (uint32_t)drillLevel) {
                         removedAllObstacles = false;
                         continue;
                     }
                 }
 
                 // --- Handle tile collision ---
-                Health *health = (Health*)ecs->find(ComponentId::Health, *hit.entity);
-                float damage = drillDamage * dt;
-                health->current -= damage;
+                bool broken = damageTile(chunk, hit.tile.tileIdx, drillDamage * dt);
 
                 // --- Update state ---
                 drilling = true;
-                if (health->current > 0) removedAllObstacles = false;
+                if (!broken) removedAllObstacles = false;
 
                 // --- Update start value ---
                 glm::vec2 diff = end - start;
@@ -995,9 +1094,9 @@ struct Game {
         ZoneScoped;
         #endif
 
-        Transform *headT = (Transform*)ecs->find(ComponentId::Transform, player.entities.front().entity);
+        Transform *headT = ecs->find<Transform>(player.entities.front().entity);
         Transform oldHeadT = *headT;
-        Mesh *headM = (Mesh*)ecs->find(ComponentId::Mesh, player.entities.front().entity);
+        Mesh *headM = ecs->find<Mesh>(player.entities.front().entity);
         const Mesh &bodyM = MeshRegistry::quad; // NOTE This might not work in the future
 
         glm::vec2 acceleration = {0.0f, 0.0f};
@@ -1021,9 +1120,7 @@ struct Game {
         if (drilling)
         {
             glm::vec2 drillTipLocal = MeshRegistry::getDrillTipLocal().pos; // not UV
-            glm::vec4 local = glm::vec4(drillTipLocal, 0.0f, 1.0f);
-            glm::vec4 world = headT->model * local;
-            glm::vec2 drillTipWorld = glm::vec2(world.x, world.y);
+            glm::vec2 drillTipWorld = headT->model.apply(drillTipLocal);
 
             if (particleTimer <= 0) {
                 particleSystem->updateSpawnFlag(drillTipWorld, SnakeMath::getRotationVector2(headT->rotation), 8);
@@ -1036,8 +1133,8 @@ struct Game {
         {
             auto entity1 = player.entities[i - 1].entity;
             auto entity2 = player.entities[i].entity;
-            Transform *t1 = (Transform*)ecs->find(ComponentId::Transform, entity1);
-            Transform *t2 = (Transform*)ecs->find(ComponentId::Transform, entity2);
+            Transform *t1 = ecs->find<Transform>(entity1);
+            Transform *t2 = ecs->find<Transform>(entity2);
             glm::vec2 prevPos = t1->position;
             glm::vec2 &pos = t2->position;
             glm::vec2 dir = prevPos - pos;
@@ -1052,12 +1149,12 @@ struct Game {
             // Optionally adjust rotation
             t2->rotation = atan2(dir.y, dir.x);
             t2->commit();
-            updateInstanceData(entity2, *t2);
+            ecs->markChanged<Transform>(entity2);
         }
 
         // Move head
         headT->commit();
-        updateInstanceData(player.entities.front().entity, *headT);
+        ecs->markChanged<Transform>(player.entities.front().entity);
     }
 
     void rotateHeadLeft(float dt) {
@@ -1065,7 +1162,7 @@ struct Game {
         ZoneScoped;
         #endif
 
-        Transform *transform = (Transform*)ecs->find(ComponentId::Transform, player.entities[2].entity);
+        Transform *transform = ecs->find<Transform>(player.entities[2].entity);
         glm::vec2 forward = SnakeMath::getRotationVector2(transform->rotation);
         glm::vec2 leftDir = glm::vec2(forward.y, -forward.x);
         glm::vec2 radiusCenter = transform->position + leftDir * rotationRadius;
@@ -1077,7 +1174,7 @@ struct Game {
         {
             // Move segment
             Entity entity = player.entities[i].entity;
-            Transform *segment = (Transform*)ecs->find(ComponentId::Transform, entity);
+            Transform *segment = ecs->find<Transform>(entity);
             glm::vec2 localCenter = segment->position - radiusCenter;
             glm::vec2 forward = SnakeMath::getRotationVector2(segment->rotation);
 
@@ -1098,6 +1195,7 @@ struct Game {
             segment->position = segment->position - dt * (localCenter);
             segment->rotation += deltaAngle * dt * rotationSpeed;
             segment->commit();
+            ecs->markChanged<Transform>(entity);
             break;
         }
     }
@@ -1107,7 +1205,7 @@ struct Game {
         ZoneScoped;
         #endif
 
-        Transform *transform = (Transform*)ecs->find(ComponentId::Transform, player.entities[2].entity);
+        Transform *transform = ecs->find<Transform>(player.entities[2].entity);
         glm::vec2 forward = SnakeMath::getRotationVector2(transform->rotation);
         glm::vec2 rightDir = glm::vec2(-forward.y, forward.x);
         glm::vec2 radiusCenter = transform->position + rightDir * rotationRadius;
@@ -1116,7 +1214,7 @@ struct Game {
         {
             // Move segment
             Entity entity = player.entities[i].entity;
-            Transform *segment = (Transform*)ecs->find(ComponentId::Transform, entity);
+            Transform *segment = ecs->find<Transform>(entity);
             glm::vec2 localCenter = segment->position - radiusCenter;
             glm::vec2 forward = SnakeMath::getRotationVector2(segment->rotation);
 
@@ -1137,6 +1235,7 @@ struct Game {
             segment->position = segment->position - dt * (localCenter);
             segment->rotation += deltaAngle * dt * rotationSpeed;
             segment->commit();
+            ecs->markChanged<Transform>(entity);
             break;
         }
     }
@@ -33,7 +33,7 @@ struct InstanceData
     Mesh mesh;
     AtlasIndex atlasIndex;
     uint64_t drawKey;
-    Entity entity;
+    uint32_t instanceKey; // See RendererInstanceStorage
 
     bool operator==(const InstanceData &other) const
     {
@@ -49,7 +49,7 @@ struct InstanceData
                mesh == other.mesh &&
                atlasIndex == other.atlasIndex &&
                drawKey == other.drawKey &&
-               entity == other.entity;
+               instanceKey == other.instanceKey;
     }
 
     static constexpr size_t ATTRIBUTE_COUNT = 8; // This always needs to match number of attributes
@@ -1,5 +1,6 @@
 #pragma once
 #include "components/Mesh.h"
+#include "Vertex.h"
 #include <vector>
 
 namespace MeshRegistry
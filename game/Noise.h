@@ -0,0 +1,183 @@
+/**
+ * Noise
+ *
+ * Seeded 2D value noise and fBm for world generation. Lattice values come from an integer hash, so the
+ * same seed and coordinate always give the same value and neighbouring chunks line up without sharing
+ * any state.
+ *
+ * fillChunk evaluates one NoiseLayer for a whole chunk per call, in tile index order (see
+ * localIndexToTileIndex). With AVX2 it does eight tiles of a column at a time, otherwise it falls back
+ * to the scalar functions. Both paths run the same operations in the same order.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include <cstdint>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOISE_AVX2 1
+#endif
+
+struct NoiseLayer
+{
+    uint32_t seed = 0;
+    float frequency = 1.0f; // Lattice cells per tile
+    uint32_t octaves = 1;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+};
+
+namespace Noise
+{
+    constexpr uint32_t OCTAVE_SEED_STEP = 0x9E3779B9u;
+    constexpr float HASH_TO_UNIT = 1.0f / 16777216.0f; // 24 bits -> [0, 1)
+
+    inline uint32_t hash(uint32_t seed, int32_t x, int32_t y)
+    {
+        uint32_t h = seed ^ (uint32_t(x) * 0x27D4EB2Du) ^ (uint32_t(y) * 0x165667B1u);
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        h *= 0x297A2D39u;
+        h ^= h >> 15;
+        return h;
+    }
+
+    inline float lattice(uint32_t seed, int32_t x, int32_t y)
+    {
+        return float(hash(seed, x, y) >> 8) * HASH_TO_UNIT;
+    }
+
+    // Smoothly interpolated lattice values, in [0, 1)
+    inline float value(uint32_t seed, float x, float y)
+    {
+        float x0 = std::floor(x);
+        float y0 = std::floor(y);
+        float tx = x - x0;
+        float ty = y - y0;
+        int32_t ix = int32_t(x0);
+        int32_t iy = int32_t(y0);
+
+        float h00 = lattice(seed, ix, iy);
+        float h10 = lattice(seed, ix + 1, iy);
+        float h01 = lattice(seed, ix, iy + 1);
+        float h11 = lattice(seed, ix + 1, iy + 1);
+
+        float ux = tx * tx * (3.0f - 2.0f * tx);
+        float uy = ty * ty * (3.0f - 2.0f * ty);
+        float a = h00 + (h10 - h00) * ux;
+        float b = h01 + (h11 - h01) * ux;
+        return a + (b - a) * uy;
+    }
+
+    // Sum of octaves, normalised back to [0, 1). x and y are in tiles.
+    inline float fbm(const NoiseLayer &layer, float x, float y)
+    {
+        float sum = 0.0f;
+        float norm = 0.0f;
+        float amplitude = 1.0f;
+        float frequency = layer.frequency;
+        uint32_t seed = layer.seed;
+        for (uint32_t octave = 0; octave < layer.octaves; octave++)
+        {
+            sum += value(seed, x * frequency, y * frequency) * amplitude;
+            norm += amplitude;
+            amplitude *= layer.gain;
+            frequency *= layer.lacunarity;
+            seed += OCTAVE_SEED_STEP;
+        }
+        return sum / norm;
+    }
+
+#ifdef NOISE_AVX2
+    inline __m256 lattice8(__m256i seed, __m256i x, __m256i y)
+    {
+        __m256i h = _mm256_xor_si256(seed, _mm256_mullo_epi32(x, _mm256_set1_epi32((int32_t)0x27D4EB2Du)));
+        h = _mm256_xor_si256(h, _mm256_mullo_epi32(y, _mm256_set1_epi32((int32_t)0x165667B1u)));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int32_t)0x2C1B3C6Du));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int32_t)0x297A2D39u));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)), _mm256_set1_ps(HASH_TO_UNIT));
+    }
+
+    inline __m256 value8(__m256i seed, __m256 x, __m256 y)
+    {
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 three = _mm256_set1_ps(3.0f);
+
+        __m256 x0 = _mm256_floor_ps(x);
+        __m256 y0 = _mm256_floor_ps(y);
+        __m256 tx = _mm256_sub_ps(x, x0);
+        __m256 ty = _mm256_sub_ps(y, y0);
+        __m256i ix = _mm256_cvttps_epi32(x0);
+        __m256i iy = _mm256_cvttps_epi32(y0);
+        __m256i ix1 = _mm256_add_epi32(ix, one);
+        __m256i iy1 = _mm256_add_epi32(iy, one);
+
+        __m256 h00 = lattice8(seed, ix, iy);
+        __m256 h10 = lattice8(seed, ix1, iy);
+        __m256 h01 = lattice8(seed, ix, iy1);
+        __m256 h11 = lattice8(seed, ix1, iy1);
+
+        __m256 ux = _mm256_mul_ps(_mm256_mul_ps(tx, tx), _mm256_sub_ps(three, _mm256_mul_ps(two, tx)));
+        __m256 uy = _mm256_mul_ps(_mm256_mul_ps(ty, ty), _mm256_sub_ps(three, _mm256_mul_ps(two, ty)));
+        __m256 a = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), ux));
+        __m256 b = _mm256_add_ps(h01, _mm256_mul_ps(_mm256_sub_ps(h11, h01), ux));
+        return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), uy));
+    }
+
+    inline __m256 fbm8(const NoiseLayer &layer, __m256 x, __m256 y)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        float norm = 0.0f;
+        float amplitude = 1.0f;
+        float frequency = layer.frequency;
+        uint32_t seed = layer.seed;
+        for (uint32_t octave = 0; octave < layer.octaves; octave++)
+        {
+            __m256 f = _mm256_set1_ps(frequency);
+            __m256 v = value8(_mm256_set1_epi32((int32_t)seed), _mm256_mul_ps(x, f), _mm256_mul_ps(y, f));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(v, _mm256_set1_ps(amplitude)));
+            norm += amplitude;
+            amplitude *= layer.gain;
+            frequency *= layer.lacunarity;
+            seed += OCTAVE_SEED_STEP;
+        }
+        return _mm256_div_ps(sum, _mm256_set1_ps(norm));
+    }
+#endif
+
+    /**
+     * Writes fbm(layer) of every tile of the chunk to out[tileIdx]. Tiles are sampled at their
+     * tile coordinate, so a chunk's right edge continues seamlessly into the next chunk.
+     */
+    inline void fillChunk(const NoiseLayer &layer, int32_t chunkWorldX, int32_t chunkWorldY, float *out)
+    {
+        int32_t tileX0 = chunkWorldX / TILE_WORLD_SIZE;
+        int32_t tileY0 = chunkWorldY / TILE_WORLD_SIZE;
+
+        for (int32_t localX = 0; localX < TILES_PER_ROW; localX++)
+        {
+            float x = float(tileX0 + localX);
+            float *column = out + localIndexToTileIndex(localX, 0);
+
+#ifdef NOISE_AVX2
+            const __m256 laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+            __m256 xs = _mm256_set1_ps(x);
+            for (int32_t localY = 0; localY < TILES_PER_ROW; localY += 8)
+            {
+                __m256 ys = _mm256_add_ps(_mm256_set1_ps(float(tileY0 + localY)), laneOffsets);
+                _mm256_storeu_ps(column + localY, fbm8(layer, xs, ys));
+            }
+#else
+            for (int32_t localY = 0; localY < TILES_PER_ROW; localY++)
+                column[localY] = fbm(layer, x, float(tileY0 + localY));
+#endif
+        }
+    }
+}
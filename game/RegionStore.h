@@ -0,0 +1,293 @@
+/**
+ * RegionStore
+ *
+ * Drilled chunks on disk. The world directory holds one world file with the seed, and one region file
+ * for every 16x16 chunks that have been drilled in:
+ *
+ *   RegionHeader        magic, version, seed, then one RegionEntry per chunk (x major, like tiles)
+ *   chunk payloads      ChunkDelta of every drilled chunk, back to back
+ *
+ * Chunks are stored as their delta against the generator, so a chunk that was never drilled has an
+ * empty entry and costs nothing. Region files are mapped, so loading a chunk from one is the page-in
+ * of its header and payload. Saving rewrites the whole region next to the old one and swaps it in.
+ *
+ * Everything is little endian, like every platform the game runs on.
+ */
+
+#pragma once
+#include "ChunkDelta.h"
+#include "MappedFile.h"
+#include "CaveSystem.h"
+#include "Chunk.h"
+#include "Logrador.h"
+#include "../libs/ankerl/unordered_dense.h"
+#include <bitset>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <tuple>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+constexpr int32_t REGION_CHUNKS_PER_SIDE = 16;
+constexpr uint32_t REGION_CHUNK_COUNT = REGION_CHUNKS_PER_SIDE * REGION_CHUNKS_PER_SIDE;
+constexpr uint32_t REGION_MAGIC = 0x47524E53; // "SNRG"
+constexpr uint32_t WORLD_MAGIC = 0x44574E53;  // "SNWD"
+constexpr uint16_t REGION_FORMAT_VERSION = 1;
+
+// Where a chunk's payload is in its region file. size == 0: the chunk is what the generator makes.
+struct RegionEntry
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct RegionHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t chunksPerSide;
+    uint32_t seed;
+    uint32_t reserved;
+    RegionEntry entries[REGION_CHUNK_COUNT];
+};
+static_assert(sizeof(RegionHeader) == 16 + REGION_CHUNK_COUNT * sizeof(RegionEntry));
+
+struct WorldHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t seed;
+};
+
+struct RegionStore
+{
+    struct Region
+    {
+        MappedFile file;
+        const RegionHeader *header = nullptr; // Null if the region has no file yet, or an unusable one
+        std::bitset<REGION_CHUNK_COUNT> rejected; // Entries whose delta didn't apply, generated instead
+    };
+
+    std::filesystem::path directory;
+    uint32_t seed = 0;
+    ankerl::unordered_dense::map<int64_t, Region> regions; // By packChunkCoords(regionX, regionY)
+    uint64_t chunksLoaded = 0;
+
+    /**
+     * Opens the world in directory, creating it with newWorldSeed if there is none.
+     * Returns the seed of the world, CaveSystem has to generate with that one.
+     */
+    uint32_t open(const std::filesystem::path &worldDirectory, uint32_t newWorldSeed)
+    {
+        directory = worldDirectory;
+        regions.clear();
+        std::filesystem::create_directories(directory);
+
+        std::filesystem::path worldPath = directory / "world.dat";
+        std::ifstream in(worldPath, std::ios::binary);
+        if (in)
+        {
+            WorldHeader header{};
+            if (!in.read((char *)&header, sizeof(header)) || header.magic != WORLD_MAGIC)
+                throw std::runtime_error("corrupt world file " + worldPath.string());
+            if (header.version != REGION_FORMAT_VERSION)
+                throw std::runtime_error("unsupported world version in " + worldPath.string());
+            seed = header.seed;
+            return seed;
+        }
+
+        seed = newWorldSeed;
+        WorldHeader header = {WORLD_MAGIC, REGION_FORMAT_VERSION, 0, seed};
+        std::ofstream out(worldPath, std::ios::binary | std::ios::trunc);
+        if (!out.write((const char *)&header, sizeof(header)))
+            throw std::runtime_error("failed to write " + worldPath.string());
+        return seed;
+    }
+
+    /**
+     * Lays the saved delta of the chunk over its freshly planned blueprint, if there is one.
+     * A region file or delta that can't be read is logged and left out, the chunk stays as generated.
+     */
+    bool restore(int64_t chunkIdx, ChunkBlueprint &blueprint)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        auto [regionX, regionY, localIdx] = locate(chunkIdx);
+        Region &region = usableRegionAt(regionX, regionY);
+        if (!region.header || region.rejected[localIdx])
+            return false;
+
+        const RegionEntry &entry = region.header->entries[localIdx];
+        if (entry.size == 0)
+            return false;
+
+        try
+        {
+            ChunkDelta::apply(region.file.data + entry.offset, entry.size, blueprint);
+        }
+        catch (const std::runtime_error &e)
+        {
+            auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(chunkIdx);
+            Logrador::err(std::string(e.what()) + " for chunk " + std::to_string(chunkWorldX) + ", " +
+                          std::to_string(chunkWorldY) + " in " + regionPath(regionX, regionY).string() +
+                          ", generating it instead");
+            region.rejected.set(localIdx);
+            return false;
+        }
+
+        chunksLoaded++;
+        return true;
+    }
+
+    /**
+     * Writes deltas (by chunk index) into their region files. Chunks of those regions that are not in
+     * deltas keep what the file had for them.
+     */
+    void save(const ankerl::unordered_dense::map<int64_t, std::vector<uint8_t>> &deltas)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        ankerl::unordered_dense::map<int64_t, std::vector<int64_t>> byRegion;
+        for (auto &[chunkIdx, delta] : deltas)
+        {
+            auto [regionX, regionY, localIdx] = locate(chunkIdx);
+            byRegion[packChunkCoords(regionX, regionY)].push_back(chunkIdx);
+        }
+
+        for (auto &[regionIdx, chunkIdxs] : byRegion)
+        {
+            auto [regionX, regionY] = unpackChunkCoords(regionIdx);
+            Region &region = usableRegionAt(regionX, regionY);
+
+            // --- Payload per chunk: the new delta, or whatever the file had ---
+            const uint8_t *payloads[REGION_CHUNK_COUNT] = {};
+            uint32_t sizes[REGION_CHUNK_COUNT] = {};
+            if (region.header)
+            {
+                for (uint32_t i = 0; i < REGION_CHUNK_COUNT; i++)
+                {
+                    if (region.rejected[i])
+                        continue; // Dropped, the chunk is what the generator makes
+                    payloads[i] = region.file.data + region.header->entries[i].offset;
+                    sizes[i] = region.header->entries[i].size;
+                }
+            }
+            for (int64_t chunkIdx : chunkIdxs)
+            {
+                const std::vector<uint8_t> &delta = deltas.at(chunkIdx);
+                uint32_t localIdx = std::get<2>(locate(chunkIdx));
+                payloads[localIdx] = delta.data();
+                sizes[localIdx] = (uint32_t)delta.size();
+            }
+
+            RegionHeader header = {REGION_MAGIC, REGION_FORMAT_VERSION, REGION_CHUNKS_PER_SIDE, seed, 0, {}};
+            uint32_t offset = sizeof(RegionHeader);
+            for (uint32_t i = 0; i < REGION_CHUNK_COUNT; i++)
+            {
+                header.entries[i] = {sizes[i] ? offset : 0, sizes[i]};
+                offset += sizes[i];
+            }
+
+            // --- Write next to the old file, then swap it in ---
+            std::filesystem::path path = regionPath(regionX, regionY);
+            std::filesystem::path tmpPath = path;
+            tmpPath += ".tmp";
+            {
+                std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+                out.write((const char *)&header, sizeof(header));
+                for (uint32_t i = 0; i < REGION_CHUNK_COUNT; i++)
+                    out.write((const char *)payloads[i], sizes[i]);
+                if (!out)
+                    throw std::runtime_error("failed to write " + tmpPath.string());
+            }
+
+            regions.erase(regionIdx); // Unmaps the old file, the payloads above are gone from here on
+            std::filesystem::rename(tmpPath, path);
+        }
+    }
+
+private:
+    // (regionX, regionY, index of the chunk inside the region)
+    static std::tuple<int32_t, int32_t, uint32_t> locate(int64_t chunkIdx)
+    {
+        auto [chunkWorldX, chunkWorldY] = unpackChunkCoords(chunkIdx);
+        int32_t chunkX = chunkWorldX / CHUNK_WORLD_SIZE;
+        int32_t chunkY = chunkWorldY / CHUNK_WORLD_SIZE;
+        int32_t regionX = floor_div(chunkX, REGION_CHUNKS_PER_SIDE);
+        int32_t regionY = floor_div(chunkY, REGION_CHUNKS_PER_SIDE);
+        uint32_t localX = uint32_t(chunkX - regionX * REGION_CHUNKS_PER_SIDE);
+        uint32_t localY = uint32_t(chunkY - regionY * REGION_CHUNKS_PER_SIDE);
+        return {regionX, regionY, localX * REGION_CHUNKS_PER_SIDE + localY};
+    }
+
+    std::filesystem::path regionPath(int32_t regionX, int32_t regionY) const
+    {
+        return directory / ("r." + std::to_string(regionX) + "." + std::to_string(regionY) + ".region");
+    }
+
+    /**
+     * regionAt, but a region file that fails its checks is kept out of the game: it is unmapped, moved
+     * aside to <name>.corrupt and the region counts as never drilled. The next save starts a fresh file.
+     */
+    Region &usableRegionAt(int32_t regionX, int32_t regionY)
+    {
+        try
+        {
+            return regionAt(regionX, regionY);
+        }
+        catch (const std::runtime_error &e)
+        {
+            Region &region = regions[packChunkCoords(regionX, regionY)];
+            region.header = nullptr;
+            region.file.close();
+
+            std::filesystem::path path = regionPath(regionX, regionY);
+            std::filesystem::path corruptPath = path;
+            corruptPath += ".corrupt";
+            std::error_code ec;
+            std::filesystem::rename(path, corruptPath, ec);
+            Logrador::err(std::string(e.what()) + ", moved to " + corruptPath.string() + ", generating its chunks instead");
+            return region;
+        }
+    }
+
+    // Maps the region file on first use and checks that it's one of ours
+    Region &regionAt(int32_t regionX, int32_t regionY)
+    {
+        auto [it, inserted] = regions.try_emplace(packChunkCoords(regionX, regionY));
+        Region &region = it->second;
+        if (!inserted)
+            return region;
+
+        std::filesystem::path path = regionPath(regionX, regionY);
+        if (!region.file.open(path.string()))
+            return region;
+
+        const RegionHeader *header = (const RegionHeader *)region.file.data;
+        if (region.file.size < sizeof(RegionHeader) || header->magic != REGION_MAGIC)
+            throw std::runtime_error("corrupt region file " + path.string());
+        if (header->version != REGION_FORMAT_VERSION || header->chunksPerSide != REGION_CHUNKS_PER_SIDE)
+            throw std::runtime_error("unsupported region file " + path.string());
+        if (header->seed != seed)
+            throw std::runtime_error("region file from another world " + path.string());
+        for (const RegionEntry &entry : header->entries)
+        {
+            if (entry.size != 0 && (entry.offset < sizeof(RegionHeader) || uint64_t(entry.offset) + entry.size > region.file.size))
+                throw std::runtime_error("corrupt region file " + path.string());
+        }
+
+        region.header = header;
+        return region;
+    }
+};
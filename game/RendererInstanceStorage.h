@@ -6,6 +6,9 @@
  * 2. Fast insertion while maintaining everything sorted by drawKey.
  * 3. Fast updates on InstanceData.
  * 4. Fast deletion of InstanceData while maintaining everything sorted by drawKey.
+ *
+ * Every instance has a key. Entities use their entity index, chunk tiles (which aren't entities) set
+ * TILE_INSTANCE_BIT and use their tile slot, see tileInstanceKey. The two kinds are mapped separately.
  */
 
 #pragma once
@@ -21,6 +24,19 @@
 #include <vector>
 #include <algorithm>
 
+constexpr uint32_t TILE_INSTANCE_BIT = 1u << 31;
+
+inline uint32_t entityInstanceKey(Entity entity)
+{
+    return entityIndex(entity);
+}
+
+// tileSlot is renderSlot * TILES_PER_CHUNK + tileIdx of a drawn chunk
+inline uint32_t tileInstanceKey(uint32_t tileSlot)
+{
+    return TILE_INSTANCE_BIT | tileSlot;
+}
+
 struct InstanceDataEntry
 {
     BlockID blockId = UINT32_MAX;
@@ -173,11 +189,17 @@ struct RendererInstanceStorage
 {
     InstanceBlockArray sortedBlocks;
     EntityInstanceMap entityInstances;
+    EntityInstanceMap tileInstances;
     WinInstanceBlockPool pool;
     std::vector<DrawCmd> drawCmds;
     uint32_t instanceCount = 0;
 
 private:
+    EntityInstanceMap &mapOf(uint32_t instanceKey)
+    {
+        return (instanceKey & TILE_INSTANCE_BIT) ? tileInstances : entityInstances;
+    }
+
     void decrementDrawCmds(uint64_t drawKey)
     {
         for (size_t i = 0; i < drawCmds.size(); ++i)
@@ -304,12 +326,13 @@ public:
 
         incrementDrawCmds(instanceData);
 
-        // --- Update entityInstances ---
-        entityInstances.set(entityIndex(instanceData.entity), entry);
+        // --- Update instance maps ---
+        uint32_t instanceKey = instanceData.instanceKey;
+        mapOf(instanceKey).set(instanceKey & ~TILE_INSTANCE_BIT, entry);
 
         // --- Update instanceCount ---
         instanceCount++;
-        assert(instanceCount == entityInstances.inserts);
+        assert(instanceCount == entityInstances.inserts + tileInstances.inserts);
     }
 
     InstanceData *find(Entity entity)
@@ -322,11 +345,29 @@ public:
         return instance;
     }
 
+    // Returns nullptr if nothing was pushed with this key
+    InstanceData *tryFind(uint32_t instanceKey)
+    {
+        EntityInstanceMap &map = mapOf(instanceKey);
+        uint32_t idx = instanceKey & ~TILE_INSTANCE_BIT;
+        if (idx >= map.capacity || map.slotEmpty(idx))
+            return nullptr;
+
+        InstanceDataEntry entry = map._data[idx];
+        return &pool.ptr(entry.blockId)->_data[entry.localIdx];
+    }
+
     void erase(Entity entity)
     {
         assert(!entityUnset(entity));
-        uint32_t entityIdx = entityIndex(entity);
-        InstanceDataEntry entry = entityInstances.get(entityIdx);
+        erase(entityInstanceKey(entity));
+    }
+
+    void erase(uint32_t instanceKey)
+    {
+        EntityInstanceMap &map = mapOf(instanceKey);
+        uint32_t idx = instanceKey & ~TILE_INSTANCE_BIT;
+        InstanceDataEntry entry = map.get(idx);
 
         // --- Update InstanceData ---
         InstanceBlock *block = pool.ptr(entry.blockId);
@@ -356,17 +397,18 @@ public:
             pool.free(entry.blockId);
         }
 
-        // --- Update entityInstances ---
+        // --- Update instance maps ---
         if (swappedInstance)
         {
-            assert(swappedInstance->entity != entity);
-            entityInstances.update(entityIndex(swappedInstance->entity), entry);
+            uint32_t swappedKey = swappedInstance->instanceKey;
+            assert(swappedKey != instanceKey);
+            mapOf(swappedKey).update(swappedKey & ~TILE_INSTANCE_BIT, entry);
         }
-        entityInstances.erase(entityIdx);
+        map.erase(idx);
 
         // --- Update instanceCount ---
         instanceCount--;
-        assert(instanceCount == entityInstances.inserts);
+        assert(instanceCount == entityInstances.inserts + tileInstances.inserts);
     }
 
     // TODO: This method should maybe be faster, but I need a baseline for how fast it could be
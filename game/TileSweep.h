@@ -0,0 +1,194 @@
+/**
+ * TileSweep
+ *
+ * Moving circle against the solid tiles of the chunk window, for the player's drill head. The sweep
+ * reports every tile the circle runs into first, so a move that grazes two tiles at once chews through
+ * both. It only needs the ChunkWindow, so bench/tile_sweep_bench.cpp can run it without a Game.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include "ChunkWindow.h"
+#include "Collision.h"
+#include "../libs/glm/glm.hpp"
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <cassert>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+struct TileHit
+{
+    int32_t tx, ty;
+    float t;
+    TileRef tile;
+};
+
+struct TileHitList
+{
+    TileRef visited[32];
+    TileHit hits[4];
+    uint32_t visitedCount = 0;
+    uint32_t count = 0;
+    float tFirst;
+
+    bool contains(const TileRef &tile) {
+        for (size_t i = 0; i < visitedCount; i++)
+            if (visited[i] == tile)
+                return true;
+        return false;
+    }
+};
+
+/**
+ * Sweeps a circle from startCenter to endCenter and collects the solid tiles it touches first: every
+ * tile whose entry time is within tEps of the earliest one, up to 4, skipping tiles out.visited
+ * already holds. Tiles are treated as their AABB inflated by radius.
+ *
+ * Grid traversal in the style of Amanatides-Woo, but of the circle's footprint (centre +- radius)
+ * instead of a point: per axis the leading edge of the footprint crosses tile boundaries in time
+ * order, and every crossing brings one new row or column of tiles into reach, as wide as the
+ * footprint is on the other axis at that moment. A tile's inflated box can't be entered before the
+ * leading edges get to it, so once the next crossing is later than the earliest hit nothing left can
+ * beat it and the walk stops. Solidity masks (Chunk::solidMask) reject a sweep with nothing solid in
+ * its bounding box up front, and every new row or column without a solid tile before it's walked.
+ */
+inline bool sweepCircleHitsSolidTilesMulti(const ChunkWindow &window, const glm::vec2& startCenter, const glm::vec2& endCenter,
+                                           float radius, TileHitList& out)
+{
+    #ifdef _DEBUG
+    ZoneScoped;
+    #endif
+
+    assert(std::isfinite(startCenter.x) && std::isfinite(startCenter.y));
+    assert(std::isfinite(endCenter.x) && std::isfinite(endCenter.y));
+    out.tFirst = 1.0f;
+    out.count = 0;
+
+    const float tEps = 1e-4f; // tune. bigger if your world scale is huge.
+    const glm::vec2 d = endCenter - startCenter;
+
+    // --- Broadphase: nothing solid anywhere near the sweep ---
+    glm::vec2 minP = glm::min(startCenter, endCenter) - glm::vec2(radius);
+    glm::vec2 maxP = glm::max(startCenter, endCenter) + glm::vec2(radius);
+    if (!window.anySolid(worldToTileCoord(minP.x), worldToTileCoord(minP.y), worldToTileCoord(maxP.x), worldToTileCoord(maxP.y)))
+        return false;
+
+    // --- Hits within tEps of the earliest so far, in no particular order ---
+    TileHit candidates[16];
+    uint32_t candidateCount = 0;
+    float bestT = 1.0f;
+    bool found = false;
+
+    auto testTile = [&](int32_t tx, int32_t ty) {
+        TileRef tile = window.tileAt(tx, ty);
+        assert(tile.chunk && "Tile outside the chunk window");
+        if (!tile.chunk->isSolid(tile.tileIdx))
+            return;
+
+        glm::vec2 bmin = glm::vec2((float)tx, (float)ty) * float(TILE_WORLD_SIZE) - glm::vec2(radius);
+        glm::vec2 bmax = bmin + glm::vec2(TILE_WORLD_SIZE + 2.0f * radius);
+        float tEnter;
+        if (!segmentIntersectsAABB(startCenter, endCenter, bmin, bmax, tEnter) || tEnter > bestT + tEps)
+            return;
+
+        if (!found || tEnter < bestT)
+        {
+            bestT = tEnter;
+            found = true;
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < candidateCount; i++)
+                if (candidates[i].t <= bestT + tEps)
+                    candidates[kept++] = candidates[i];
+            candidateCount = kept;
+        }
+
+        if (candidateCount < std::size(candidates))
+            candidates[candidateCount++] = { tx, ty, tEnter, tile };
+    };
+
+    // --- Walk the leading edge of the footprint on each axis, earliest crossing first ---
+    const float inf = std::numeric_limits<float>::infinity();
+    const float tileSize = float(TILE_WORLD_SIZE);
+    int32_t line[2];      // Outermost row/column in reach on the leading side
+    int32_t step[2];
+    int32_t remaining[2]; // Crossings left until the end position, exact so float drift can't overrun
+    float tNext[2];       // When the leading edge crosses its next tile boundary
+    float tDelta[2];      // Time between boundaries
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        float v = d[axis];
+        step[axis] = v < 0.0f ? -1 : 1;
+        float edge = startCenter[axis] + float(step[axis]) * radius;
+        line[axis] = worldToTileCoord(edge);
+        remaining[axis] = std::abs(worldToTileCoord(endCenter[axis] + float(step[axis]) * radius) - line[axis]);
+        tNext[axis] = inf;
+        tDelta[axis] = inf;
+        if (v != 0.0f)
+        {
+            float boundary = float(step[axis] > 0 ? line[axis] + 1 : line[axis]) * tileSize;
+            tNext[axis] = (boundary - edge) / v;
+            tDelta[axis] = tileSize / std::abs(v);
+        }
+    }
+
+    // Rows/columns the footprint covers on an axis at time t
+    auto reach = [&](int axis, float t, int32_t &lo, int32_t &hi) {
+        float center = startCenter[axis] + d[axis] * t;
+        lo = worldToTileCoord(center - radius);
+        hi = worldToTileCoord(center + radius);
+    };
+
+    int32_t loX, hiX, loY, hiY;
+    reach(0, 0.0f, loX, hiX);
+    reach(1, 0.0f, loY, hiY);
+    for (int32_t ty = loY; ty <= hiY; ++ty)
+        for (int32_t tx = loX; tx <= hiX; ++tx)
+            testTile(tx, ty);
+
+    while (remaining[0] > 0 || remaining[1] > 0)
+    {
+        int axis = remaining[1] == 0 || (remaining[0] > 0 && tNext[0] <= tNext[1]) ? 0 : 1;
+        float t = tNext[axis];
+        if (found && t > bestT + tEps)
+            break;
+        tNext[axis] += tDelta[axis];
+        remaining[axis]--;
+        line[axis] += step[axis];
+
+        int32_t lo, hi;
+        reach(axis ^ 1, std::min(t, 1.0f), lo, hi);
+        bool lineSolid = axis == 0 ? window.anySolid(line[0], lo, line[0], hi)
+                                   : window.anySolid(lo, line[1], hi, line[1]);
+        if (!lineSolid)
+            continue;
+        for (int32_t k = lo; k <= hi; ++k)
+        {
+            if (axis == 0) testTile(line[0], k);
+            else testTile(k, line[1]);
+        }
+    }
+
+    if (!found) return false;
+
+    // --- Gather all hits at the same time ---
+    out.tFirst = bestT;
+    std::sort(candidates, candidates + candidateCount, [](const TileHit &a, const TileHit &b) { return a.t < b.t; });
+    for (uint32_t i = 0; i < candidateCount && out.count < 4; i++)
+    {
+        const TileHit &hit = candidates[i];
+        if (hit.t > bestT + tEps || out.contains(hit.tile))
+            continue;
+
+        out.hits[out.count++] = hit;
+        out.visited[out.visitedCount++] = hit.tile;
+    }
+
+    return out.count > 0;
+}
@@ -0,0 +1,124 @@
+// VirtualMemory.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// ------------------------------------------------------------
+// Reserve / commit / release of address space
+// ------------------------------------------------------------
+namespace VirtualMemory
+{
+    inline size_t pageSize()
+    {
+        static size_t cached = 0;
+        if (!cached)
+        {
+#if defined(_WIN32)
+            SYSTEM_INFO si{};
+            GetSystemInfo(&si);
+            cached = (size_t)si.dwPageSize;
+#else
+            cached = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+            assert((cached & (cached - 1)) == 0 && "Page size should be power-of-two");
+        }
+        return cached;
+    }
+
+    inline size_t alignUp(size_t v, size_t a)
+    {
+        return (v + (a - 1)) & ~(a - 1);
+    }
+
+    // Reserves address space only. Nothing is backed by memory until it's committed.
+    inline void *reserve(size_t bytes)
+    {
+#if defined(_WIN32)
+        return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+        void *p = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        return p == MAP_FAILED ? nullptr : p;
+#endif
+    }
+
+    // Newly committed pages read as zero and are only backed by physical memory once touched.
+    inline bool commit(void *addr, size_t bytes)
+    {
+#if defined(_WIN32)
+        return VirtualAlloc(addr, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+        return mprotect(addr, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+    }
+
+    inline void release(void *addr, size_t bytes)
+    {
+#if defined(_WIN32)
+        (void)bytes;
+        VirtualFree(addr, 0, MEM_RELEASE);
+#else
+        munmap(addr, bytes);
+#endif
+    }
+}
+
+// ------------------------------------------------------------
+// A reserved range that is committed front to back
+// ------------------------------------------------------------
+struct VirtualRange
+{
+    uint8_t *base = nullptr;
+    size_t reservedBytes = 0;
+    size_t committedBytes = 0;
+
+    void reserve(size_t bytes)
+    {
+        assert(base == nullptr);
+        reservedBytes = VirtualMemory::alignUp(bytes, VirtualMemory::pageSize());
+        base = (uint8_t *)VirtualMemory::reserve(reservedBytes);
+        if (!base)
+            throw std::bad_alloc();
+    }
+
+    // Makes sure the first `bytes` of the range are usable. Returns the previously committed size,
+    // which is where the fresh pages start.
+    size_t commitTo(size_t bytes)
+    {
+        assert(base);
+        size_t oldCommittedBytes = committedBytes;
+        bytes = VirtualMemory::alignUp(bytes, VirtualMemory::pageSize());
+        if (bytes <= committedBytes)
+            return oldCommittedBytes;
+
+        if (bytes > reservedBytes || !VirtualMemory::commit(base + committedBytes, bytes - committedBytes))
+            throw std::bad_alloc();
+
+        committedBytes = bytes;
+        return oldCommittedBytes;
+    }
+
+    void release()
+    {
+        if (base)
+            VirtualMemory::release(base, reservedBytes);
+        base = nullptr;
+        reservedBytes = 0;
+        committedBytes = 0;
+    }
+};
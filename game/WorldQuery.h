@@ -0,0 +1,335 @@
+/**
+ * WorldQuery
+ *
+ * Questions about the tiles of the chunk window, asked in batches: the first solid tile along a ray, the
+ * tiles with ore (or anything else on them) within a radius, the tiles under a rectangle. Add queries to
+ * a WorldQueryBatch, run it once, and read every query's hits out of one flat buffer. The buffers are
+ * kept between batches, so a system that asks the same kind of questions every frame doesn't allocate.
+ *
+ * Every query works chunk by chunk and skips chunks that can't match before looking at a single tile:
+ * for TileFilter::Solid a Chunk::anySolid over the part of the chunk the query covers, for
+ * TileFilter::Overlay a chunk without overlays. Solid tiles are then read straight from solidMask bits,
+ * a tile column at a time, so a ray costs one step per column it crosses rather than one per tile, and a
+ * long ray through open cave a few steps per chunk.
+ *
+ * Chunks outside the window are left out of rect and circle queries. A solid ray stops at them, like
+ * ChunkWindow::anySolid they count as solid, and the hit has no chunk.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include "ChunkWindow.h"
+#include "Collision.h"
+#include "../libs/glm/glm.hpp"
+#include <vector>
+#include <span>
+#include <bit>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+// PROFILING
+#ifdef _DEBUG
+#include "tracy/Tracy.hpp"
+#endif
+
+enum class TileFilter : uint8_t
+{
+    Solid,   // Any tile that isn't empty
+    Overlay, // Tiles with something on them (ore, cosmetics), see Chunk::tileOverlays
+};
+
+enum class WorldQueryShape : uint8_t
+{
+    Ray,    // a to b
+    Rect,   // Tiles overlapping min a, max b
+    Circle, // Tiles overlapping centre a, radius
+};
+
+struct WorldQuery
+{
+    WorldQueryShape shape;
+    TileFilter filter;
+    uint32_t maxHits;
+    glm::vec2 a;
+    glm::vec2 b;
+    float radius;
+};
+
+struct WorldQueryHit
+{
+    TileRef tile; // Without chunk if a ray ran out of the window
+    int32_t tileX;
+    int32_t tileY;
+    float t;      // Rays: where along a to b the ray enters the tile, 0..1. Always 0 for areas.
+};
+
+// Range of a query's hits in WorldQueryBatch::hits
+struct WorldQueryResult
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+struct WorldQueryBatch
+{
+    std::vector<WorldQuery> queries;
+    std::vector<WorldQueryResult> results; // One per query that has been run
+    std::vector<WorldQueryHit> hits;
+
+    // The tiles from `from` to `to` that pass filter, nearest first. Returns the query's index.
+    uint32_t raycast(glm::vec2 from, glm::vec2 to, TileFilter filter = TileFilter::Solid, uint32_t maxHits = 1)
+    {
+        return add({WorldQueryShape::Ray, filter, maxHits, from, to, 0.0f});
+    }
+
+    uint32_t rect(glm::vec2 min, glm::vec2 max, TileFilter filter = TileFilter::Solid, uint32_t maxHits = UINT32_MAX)
+    {
+        assert(min.x <= max.x && min.y <= max.y);
+        return add({WorldQueryShape::Rect, filter, maxHits, min, max, 0.0f});
+    }
+
+    uint32_t circle(glm::vec2 center, float radius, TileFilter filter = TileFilter::Solid, uint32_t maxHits = UINT32_MAX)
+    {
+        assert(radius >= 0.0f);
+        return add({WorldQueryShape::Circle, filter, maxHits, center, center, radius});
+    }
+
+    // Answers every query added since the last run
+    void run(const ChunkWindow &window)
+    {
+        #ifdef _DEBUG
+        ZoneScoped;
+        #endif
+
+        for (size_t i = results.size(); i < queries.size(); i++)
+        {
+            const WorldQuery &query = queries[i];
+            WorldQueryResult result = {(uint32_t)hits.size(), 0};
+            if (query.maxHits > 0)
+            {
+                if (query.shape == WorldQueryShape::Ray)
+                    runRay(window, query);
+                else
+                    runArea(window, query);
+            }
+            result.count = (uint32_t)hits.size() - result.first;
+            results.push_back(result);
+        }
+    }
+
+    std::span<const WorldQueryHit> hitsOf(uint32_t query) const
+    {
+        assert(query < results.size() && "Query hasn't been run");
+        const WorldQueryResult &result = results[query];
+        return {hits.data() + result.first, result.count};
+    }
+
+    void clear()
+    {
+        queries.clear();
+        results.clear();
+        hits.clear();
+    }
+
+private:
+    uint32_t add(const WorldQuery &query)
+    {
+        queries.push_back(query);
+        return (uint32_t)queries.size() - 1;
+    }
+
+    static bool passes(const Chunk &chunk, uint32_t tileIdx, TileFilter filter)
+    {
+        if (filter == TileFilter::Solid)
+            return chunk.isSolid(tileIdx);
+        return chunk.tileOverlays[tileIdx] != NO_TILE_OVERLAY;
+    }
+
+    // False if nothing in the inclusive local rectangle can pass filter
+    static bool mayPass(const Chunk &chunk, int32_t localX0, int32_t localY0, int32_t localX1, int32_t localY1, TileFilter filter)
+    {
+        if (filter == TileFilter::Solid)
+            return chunk.anySolid(localX0, localY0, localX1, localY1);
+        return !chunk.overlays.empty(); // Broken overlays stay in the list, so this only ever says maybe
+    }
+
+    /**
+     * Walks the ray one tile column at a time. The ray covers one run of rows in each column, which is
+     * one AND against the column's solidMask word (per chunk it spans), and the set bits left over are
+     * the hits of that column, in ray order. Where ChunkWindow::anySolid finds nothing solid under the
+     * ray's run through a chunk, the whole chunk is skipped.
+     */
+    void runRay(const ChunkWindow &window, const WorldQuery &query)
+    {
+        uint32_t first = (uint32_t)hits.size();
+        glm::vec2 a = query.a;
+        glm::vec2 dir = query.b - query.a;
+        int32_t firstTileX = worldToTileCoord(a.x);
+        int32_t lastTileX = worldToTileCoord(query.b.x);
+        int32_t stepX = lastTileX >= firstTileX ? 1 : -1;
+        int32_t stepY = dir.y >= 0.0f ? 1 : -1;
+        float invX = 1.0f / dir.x; // Only used when the ray crosses columns, so dir.x isn't 0
+        float invY = 1.0f / dir.y; // Only used when the ray crosses rows
+
+        // t at which the ray leaves column tileX, or enters row tileY
+        auto columnExit = [&](int32_t tileX) {
+            return tileX == lastTileX ? 1.0f : (float((stepX > 0 ? tileX + 1 : tileX) * TILE_WORLD_SIZE) - a.x) * invX;
+        };
+        auto rowEntry = [&](int32_t tileY) {
+            return (float((stepY > 0 ? tileY : tileY + 1) * TILE_WORLD_SIZE) - a.y) * invY;
+        };
+
+        int32_t tileX = firstTileX;
+        float tIn = 0.0f;
+        float yIn = a.y;
+        while (true)
+        {
+            // --- Skip the rest of this chunk if the ray meets nothing solid in it ---
+            bool chunkStart = tileX == firstTileX || (tileX & CHUNK_MASK) == (stepX > 0 ? 0 : CHUNK_MASK);
+            if (query.filter == TileFilter::Solid && chunkStart)
+            {
+                int32_t endX = stepX > 0 ? std::min(tileX | CHUNK_MASK, lastTileX) : std::max(tileX & ~CHUNK_MASK, lastTileX);
+                float tEnd = columnExit(endX);
+                float yEnd = endX == lastTileX ? query.b.y : a.y + dir.y * tEnd;
+                int32_t tileY0 = worldToTileCoord(std::min(yIn, yEnd));
+                int32_t tileY1 = worldToTileCoord(std::max(yIn, yEnd));
+                if (!window.anySolid(std::min(tileX, endX), tileY0, std::max(tileX, endX), tileY1))
+                {
+                    if (endX == lastTileX)
+                        return;
+                    tileX = endX + stepX;
+                    tIn = tEnd;
+                    yIn = yEnd;
+                    continue;
+                }
+            }
+
+            // --- Rows the ray covers in this column ---
+            float tOut = columnExit(tileX);
+            float yOut = tileX == lastTileX ? query.b.y : a.y + dir.y * tOut;
+            int32_t firstTileY = worldToTileCoord(yIn);
+            int32_t lastTileY = worldToTileCoord(yOut);
+            if ((lastTileY - firstTileY) * stepY < 0)
+                lastTileY = firstTileY; // Rounding, the ray can't go back
+
+            int32_t chunkX = tileToChunkCoord(tileX);
+            int32_t localX = tileX & CHUNK_MASK;
+            for (int32_t tileY = firstTileY;;)
+            {
+                // Part of the run inside one chunk
+                int32_t endY = stepY > 0 ? std::min(tileY | CHUNK_MASK, lastTileY) : std::max(tileY & ~CHUNK_MASK, lastTileY);
+                int32_t chunkY = tileToChunkCoord(tileY);
+                Chunk *chunk = window.find(chunkX, chunkY);
+                if (!chunk)
+                {
+                    if (query.filter == TileFilter::Solid)
+                    {
+                        float t = tileY == firstTileY ? tIn : std::max(tIn, rowEntry(tileY));
+                        hits.push_back({{}, tileX, tileY, t});
+                        return;
+                    }
+                }
+                else
+                {
+                    int32_t localY0 = std::min(tileY, endY) & CHUNK_MASK;
+                    int32_t localY1 = std::max(tileY, endY) & CHUNK_MASK;
+                    uint32_t column = (UINT32_MAX >> (CHUNK_MASK - (localY1 - localY0))) << localY0;
+                    if (query.filter == TileFilter::Solid)
+                        column &= chunk->solidMask[localX];
+                    else if (chunk->overlays.empty())
+                        column = 0;
+
+                    while (column)
+                    {
+                        int32_t localY = stepY > 0 ? std::countr_zero(column) : CHUNK_MASK - std::countl_zero(column);
+                        column &= ~(1u << localY);
+
+                        uint32_t tileIdx = (uint32_t)localIndexToTileIndex(localX, localY);
+                        if (query.filter != TileFilter::Solid && !passes(*chunk, tileIdx, query.filter))
+                            continue;
+
+                        int32_t hitY = (chunkY << CHUNK_SHIFT) + localY;
+                        float t = hitY == firstTileY ? tIn : std::max(tIn, rowEntry(hitY));
+                        hits.push_back({{chunk, tileIdx}, tileX, hitY, t});
+                        if (hits.size() - first == query.maxHits)
+                            return;
+                    }
+                }
+
+                if (endY == lastTileY)
+                    break;
+                tileY = endY + stepY;
+            }
+
+            if (tileX == lastTileX)
+                return;
+            tileX += stepX;
+            tIn = tOut;
+            yIn = yOut;
+        }
+    }
+
+    void runArea(const ChunkWindow &window, const WorldQuery &query)
+    {
+        uint32_t first = (uint32_t)hits.size();
+        bool circle = query.shape == WorldQueryShape::Circle;
+        glm::vec2 min = circle ? query.a - glm::vec2(query.radius) : query.a;
+        glm::vec2 max = circle ? query.a + glm::vec2(query.radius) : query.b;
+        int32_t tileX0 = worldToTileCoord(min.x);
+        int32_t tileY0 = worldToTileCoord(min.y);
+        int32_t tileX1 = worldToTileCoord(max.x);
+        int32_t tileY1 = worldToTileCoord(max.y);
+
+        for (int32_t chunkX = tileToChunkCoord(tileX0); chunkX <= tileToChunkCoord(tileX1); chunkX++)
+        {
+            for (int32_t chunkY = tileToChunkCoord(tileY0); chunkY <= tileToChunkCoord(tileY1); chunkY++)
+            {
+                Chunk *chunk = window.find(chunkX, chunkY);
+                if (!chunk)
+                    continue;
+
+                int32_t firstTileX = chunkX << CHUNK_SHIFT;
+                int32_t firstTileY = chunkY << CHUNK_SHIFT;
+                int32_t localX0 = std::max(tileX0 - firstTileX, 0);
+                int32_t localY0 = std::max(tileY0 - firstTileY, 0);
+                int32_t localX1 = std::min(tileX1 - firstTileX, CHUNK_MASK);
+                int32_t localY1 = std::min(tileY1 - firstTileY, CHUNK_MASK);
+                if (!mayPass(*chunk, localX0, localY0, localX1, localY1, query.filter))
+                    continue;
+
+                uint32_t rows = (UINT32_MAX >> (CHUNK_MASK - (localY1 - localY0))) << localY0;
+                for (int32_t localX = localX0; localX <= localX1; localX++)
+                {
+                    // Candidate tiles of this column as bits, Overlay has no mask to start from
+                    uint32_t column = rows;
+                    if (query.filter == TileFilter::Solid)
+                        column &= chunk->solidMask[localX];
+
+                    while (column)
+                    {
+                        int32_t localY = std::countr_zero(column);
+                        column &= column - 1;
+
+                        uint32_t tileIdx = (uint32_t)localIndexToTileIndex(localX, localY);
+                        if (query.filter != TileFilter::Solid && !passes(*chunk, tileIdx, query.filter))
+                            continue;
+
+                        int32_t tileX = firstTileX + localX;
+                        int32_t tileY = firstTileY + localY;
+                        if (circle)
+                        {
+                            glm::vec2 tileMin = glm::vec2((float)tileX, (float)tileY) * float(TILE_WORLD_SIZE);
+                            if (!circleIntersectsAABB(query.a, query.radius, {tileMin, tileMin + glm::vec2(TILE_WORLD_SIZE)}))
+                                continue;
+                        }
+
+                        hits.push_back({{chunk, tileIdx}, tileX, tileY, 0.0f});
+                        if (hits.size() - first == query.maxHits)
+                            return;
+                    }
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,112 @@
+/**
+ * WorldRandom
+ *
+ * Stateless random numbers for world generation. A number is a pure function of
+ * (world seed, chunk, tile index, purpose), so a chunk comes out the same no matter which thread
+ * generates it, in which order, or how often. Use a separate RandomPurpose for every independent
+ * decision, otherwise two decisions about the same tile end up correlated.
+ *
+ * The batch form fills one number per tile of a chunk, eight at a time with AVX2.
+ */
+
+#pragma once
+#include "Chunk.h"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WORLD_RANDOM_AVX2 1
+#endif
+
+enum class RandomPurpose : uint32_t
+{
+    Cosmetic,
+    CosmeticVariant,
+    Ore,
+    OreBand,
+};
+
+namespace WorldRandom
+{
+    constexpr float BITS_TO_UNIT = 1.0f / 16777216.0f; // 24 bits -> [0, 1)
+    constexpr uint32_t TILE_STEP = 0x9E3779B9u;
+
+    inline uint32_t mix(uint32_t h)
+    {
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    // Everything but the tile index, hashed once per chunk and purpose
+    inline uint32_t chunkKey(uint32_t seed, int32_t chunkWorldX, int32_t chunkWorldY, RandomPurpose purpose)
+    {
+        uint32_t h = mix(seed ^ 0x5BD1E995u);
+        h = mix(h ^ uint32_t(chunkWorldX / CHUNK_WORLD_SIZE));
+        h = mix(h ^ uint32_t(chunkWorldY / CHUNK_WORLD_SIZE));
+        return mix(h ^ uint32_t(purpose));
+    }
+
+    inline uint32_t bitsAt(uint32_t chunkKey, uint32_t tileIdx)
+    {
+        return mix(chunkKey + tileIdx * TILE_STEP);
+    }
+
+    inline uint32_t bits(uint32_t seed, int32_t chunkWorldX, int32_t chunkWorldY, uint32_t tileIdx, RandomPurpose purpose)
+    {
+        return bitsAt(chunkKey(seed, chunkWorldX, chunkWorldY, purpose), tileIdx);
+    }
+
+    // [0, 1)
+    inline float unit(uint32_t seed, int32_t chunkWorldX, int32_t chunkWorldY, uint32_t tileIdx, RandomPurpose purpose)
+    {
+        return float(bits(seed, chunkWorldX, chunkWorldY, tileIdx, purpose) >> 8) * BITS_TO_UNIT;
+    }
+
+    inline bool chance(uint32_t seed, int32_t chunkWorldX, int32_t chunkWorldY, uint32_t tileIdx, RandomPurpose purpose, float probability)
+    {
+        return unit(seed, chunkWorldX, chunkWorldY, tileIdx, purpose) < probability;
+    }
+
+    // [0, n), without modulo bias worth mentioning for small n
+    inline uint32_t below(uint32_t seed, int32_t chunkWorldX, int32_t chunkWorldY, uint32_t tileIdx, RandomPurpose purpose, uint32_t n)
+    {
+        return uint32_t((uint64_t(bits(seed, chunkWorldX, chunkWorldY, tileIdx, purpose)) * n) >> 32);
+    }
+
+    /**
+     * out[tileIdx] = unit(seed, chunk, tileIdx, purpose) for every tile of the chunk
+     */
+    inline void fillUnit(uint32_t seed, int32_t chunkWorldX, int32_t chunkWorldY, RandomPurpose purpose, float *out)
+    {
+        uint32_t key = chunkKey(seed, chunkWorldX, chunkWorldY, purpose);
+
+#ifdef WORLD_RANDOM_AVX2
+        const __m256i step8 = _mm256_set1_epi32(int32_t(8 * TILE_STEP));
+        const __m256i mul1 = _mm256_set1_epi32(int32_t(0x7FEB352Du));
+        const __m256i mul2 = _mm256_set1_epi32(int32_t(0x846CA68Bu));
+        const __m256 toUnit = _mm256_set1_ps(BITS_TO_UNIT);
+
+        __m256i counter = _mm256_add_epi32(
+            _mm256_set1_epi32(int32_t(key)),
+            _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(TILE_STEP))));
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx += 8)
+        {
+            __m256i h = counter;
+            h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+            h = _mm256_mullo_epi32(h, mul1);
+            h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+            h = _mm256_mullo_epi32(h, mul2);
+            h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+            _mm256_storeu_ps(out + tileIdx, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)), toUnit));
+            counter = _mm256_add_epi32(counter, step8);
+        }
+#else
+        for (uint32_t tileIdx = 0; tileIdx < TILES_PER_CHUNK; tileIdx++)
+            out[tileIdx] = float(bitsAt(key, tileIdx) >> 8) * BITS_TO_UNIT;
+#endif
+    }
+}
@@ -4,18 +4,26 @@
 
 #include "../../libs/glm/glm.hpp"
 
-const uint32_t MAX_AABB_NODES = 4;
-
-// ---- Forward declarations ----
-struct AABB;
-struct AABBNode;
-struct AABBNodePool;
-struct AABBNodePoolBoy;
-
 struct AABB
 {
     glm::vec2 min; 
     glm::vec2 max; 
 
     glm::vec2 size() const { return max - min; }
+    float perimeter() const { return 2.0f * ((max.x - min.x) + (max.y - min.y)); }
+
+    bool overlaps(const AABB &other) const
+    {
+        return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y;
+    }
+
+    bool contains(const AABB &other) const
+    {
+        return min.x <= other.min.x && min.y <= other.min.y && other.max.x <= max.x && other.max.y <= max.y;
+    }
 };
+
+inline AABB mergeAABB(const AABB &a, const AABB &b)
+{
+    return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
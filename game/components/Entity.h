@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <utility>
+#include <functional>
 
 static const uint32_t ENTITY_SENTINEL_ID = 0xFFFFFFFF;
 
@@ -22,15 +23,15 @@ struct Entity
     }
 };
 
-inline uint32_t entityIndex(Entity &e)
+inline uint32_t entityIndex(const Entity &e)
 {
     return e.id & 0x00FFFFFF;
 }
 
-inline uint8_t entityGen(Entity &e) { return (e.id >> 24) & 0xFF; }
+inline uint8_t entityGen(const Entity &e) { return (e.id >> 24) & 0xFF; }
 
 
-inline bool entityUnset(Entity &e) { return e.id == ENTITY_SENTINEL_ID; };
+inline bool entityUnset(const Entity &e) { return e.id == ENTITY_SENTINEL_ID; };
 
 // Specialize std::hash for Entity
 namespace std
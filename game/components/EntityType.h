@@ -4,7 +4,6 @@
 enum class EntityType : uint8_t
 {
     Player,
-    Ground,
     Background,
     GroundCosmetic,
     OreBlock,
@@ -1,8 +0,0 @@
-#pragma once
-#include "Entity.h"
-#include <optional>
-
-struct Ground 
-{
-    std::optional<Entity> groundOreRef;
-};
\ No newline at end of file
@@ -1,7 +0,0 @@
-#pragma once
-#include "Entity.h"
-
-struct GroundCosmetic
-{
-    Entity parentRef;
-};
\ No newline at end of file
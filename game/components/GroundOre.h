@@ -1,10 +1,8 @@
 #pragma once
-#include "Entity.h"
 #include "../Item.h"
 
 struct GroundOre 
 {
     ItemId itemId;
-    Entity parentRef;
     OreLevel oreLevel;
 };
\ No newline at end of file
@@ -1,7 +0,0 @@
-#pragma once
-
-struct Health
-{
-    float current;
-    float max;
-};
\ No newline at end of file
@@ -1,24 +1,27 @@
 #pragma once
 #include "../libs/glm/glm.hpp"
 #include "../libs/glm/ext/matrix_transform.hpp"
+#include "../Affine2.h"
+#include <cmath>
 
 // PROFILING
 #ifdef _DEBUG
 #include "tracy/Tracy.hpp"
 #endif
 
+inline constexpr glm::vec2 DEFAULT_PIVOT = {0.5f, 0.5f}; // Centre
+
+// Hot part of an entity's placement, read every time instances are built or synced.
+// Debug names and non default pivots live in TransformMeta.
 struct Transform
 {
     glm::vec2 position;
     glm::vec2 size;
-    glm::vec2 dir = glm::vec2(0.0f);
     float rotation = 0.0f;
-    glm::vec2 pivotPoint = {0.5f, 0.5f};
-    const char *name = "not defined";
-    glm::mat4 model = glm::mat4(1.0f);
+    Affine2 model;
 
-    void commit() {
-        model = transformToModelMatrix();
+    void commit(glm::vec2 pivotPoint = DEFAULT_PIVOT) {
+        model = Affine2::fromPlacement(position, size, rotation, pivotPoint);
     }
 
     glm::vec2 getCenter() {
@@ -28,23 +31,16 @@ struct Transform
     float getRadius() {
         return size.x / 2;
     }
-
-private:
-    // Very slow method
-    glm::mat4 transformToModelMatrix()
-    {
-        #ifdef _DEBUG
-        ZoneScoped;
-        #endif
-
-        glm::vec2 pivotOffset = this->size * this->pivotPoint;
-        glm::mat4 model = glm::mat4(1.0f);                            // Identity matrix
-        model = glm::translate(model, glm::vec3(position, 0.0f));     // Append transform to the new matrix
-        model = glm::translate(model, glm::vec3(pivotOffset, 0.0f));  // move pivot
-        model = glm::rotate(model, rotation, glm::vec3(0, 0, 1));     // rotate around pivot
-        model = glm::translate(model, glm::vec3(-pivotOffset, 0.0f)); // undo pivot
-        model = glm::scale(model, glm::vec3(size, 1.0f));             // finally scale quad
-
-        return model;
-    }
 };
+
+// Placement between a and b (alpha 0..1), turning the short way round. Committed.
+inline Transform interpolateTransform(const Transform &a, const Transform &b, float alpha)
+{
+    Transform t = b;
+    t.position = glm::mix(a.position, b.position, alpha);
+    t.size = glm::mix(a.size, b.size, alpha);
+    float turn = std::remainder(b.rotation - a.rotation, 6.28318530718f);
+    t.rotation = a.rotation + turn * alpha;
+    t.commit();
+    return t;
+}
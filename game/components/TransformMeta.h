@@ -0,0 +1,9 @@
+#pragma once
+#include "Transform.h"
+
+// Cold side of Transform. Only entities that need a name or a custom pivot carry one.
+struct TransformMeta
+{
+    glm::vec2 pivotPoint = DEFAULT_PIVOT;
+    const char *name = "not defined";
+};
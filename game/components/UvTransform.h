@@ -0,0 +1,7 @@
+#pragma once
+#include "../../libs/glm/glm.hpp"
+
+struct UvTransform
+{
+    glm::vec4 value; // (uOffset, vOffset, uScale, vScale)
+};